@@ -1,11 +1,16 @@
 #include "include/PcapLib/Lidar2DViewer.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 
-Lidar2DViewer::Lidar2DViewer(int width, int height)
-    : windowWidth(width), windowHeight(height),
-      windowName("LIDAR 2D Viewer"), isWindowCreated(true),
-      canvas(cv::Mat::zeros(height, width, CV_8UC3))  // Khởi tạo luôn
+Lidar2DViewer::Lidar2DViewer(int width, int height, bool headless)
+    : canvas(cv::Mat::zeros(height, width, CV_8UC3)),  // Khởi tạo luôn
+      windowWidth(width), windowHeight(height),
+      windowName("LIDAR 2D Viewer"), isWindowCreated(!headless), headless(headless)
 {
-    cv::namedWindow(windowName, cv::WINDOW_AUTOSIZE);
+    if (!headless) {
+        cv::namedWindow(windowName, cv::WINDOW_AUTOSIZE);
+    }
 }
 
 Lidar2DViewer::~Lidar2DViewer() {
@@ -18,21 +23,236 @@ void Lidar2DViewer::update(const std::vector<cv::Point2f>& lidarPoints,
 {
     if (lidarPoints.empty()) return;
 
-    int radius = std::max(1, pointSize / 2);
-    for (const auto& point : lidarPoints) {
-        cv::circle(canvas, point, radius, pointColor, cv::FILLED);
+    const size_t n = lidarPoints.size();
+    if (screenX.size() < n) {
+        screenX.resize(n);
+        screenY.resize(n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        screenX[i] = lidarPoints[i].x;
+        screenY[i] = lidarPoints[i].y;
     }
+
+    int radius = std::max(1, pointSize / 2);
+    splatter.splat(canvas, screenX.data(), screenY.data(), n, pointColor, radius);
+}
+
+
+void Lidar2DViewer::update(const PointCloudSoA& cloud,
+                           float scale,
+                           const cv::Scalar& pointColor,
+                           int pointSize)
+{
+    draw_cloud(canvas, cloud, scale, pointColor, pointSize);
 }
 
+void Lidar2DViewer::draw_cloud(cv::Mat& target,
+                               const PointCloudSoA& cloud,
+                               float scale,
+                               const cv::Scalar& pointColor,
+                               int pointSize)
+{
+    const size_t n = cloud.size();
+    if (n == 0) return;
+
+    if (screenX.size() < n) {
+        screenX.resize(n);
+        screenY.resize(n);
+    }
 
+    // chieu 2 cot x, y sang pixel (vong lap don gian, compiler vector hoa duoc)
+    const float cx = static_cast<float>(windowWidth / 2);
+    const float cy = static_cast<float>(windowHeight / 2);
+    const float* xs = cloud.x.data();
+    const float* ys = cloud.y.data();
+    float* px = screenX.data();
+    float* py = screenY.data();
+    {
+        StageTimer timer(STAGE_PROJECT);
+        for (size_t i = 0; i < n; i++) {
+            px[i] = cx - xs[i] * scale;
+            py[i] = cy - ys[i] * scale;
+        }
+    }
+
+    int radius = std::max(1, pointSize / 2);
+    splatter.splat(target, px, py, n, pointColor, radius);
+}
 
 void Lidar2DViewer::show() {
     if (isWindowCreated) {
+        StageTimer timer(STAGE_IMSHOW);
         cv::imshow(windowName, canvas);
     }
 }
 
+//=============================================================
+// Render thread
+//=============================================================
+void Lidar2DViewer::start_render(double fps) {
+    if (rendering.load() || headless) return;
+    renderFps = fps > 0 ? fps : VIEWER_DEFAULT_FPS;
+
+    // HighGUI chi goi tu 1 thread: cua so tao o constructor duoc tao lai trong render thread
+    if (isWindowCreated) {
+        cv::destroyWindow(windowName);
+        isWindowCreated = false;
+    }
+    for (auto& buffer : buffers) {
+        buffer = cv::Mat::zeros(windowHeight, windowWidth, CV_8UC3);
+    }
+    backIndex = 0;
+    frontIndex = 1;
+    readyState.store(2);
+
+    rendering.store(true);
+    renderThread = std::thread(&Lidar2DViewer::render_loop, this);
+}
+
+void Lidar2DViewer::stop_render() {
+    if (!rendering.exchange(false)) return;
+    renderThread.join();
+}
+
+// ve frame bang draw(canvas) roi dua len render thread (hoac hien thi ngay neu khong co)
+template <typename DrawFn>
+void Lidar2DViewer::publish_with(DrawFn&& draw) {
+    publishedFrames.fetch_add(1, std::memory_order_relaxed);
+    if (headless && !frameWriter) return;   // chay toi da toc do: khong ve gi
+
+    if (!rendering.load(std::memory_order_relaxed)) {
+        {
+            StageTimer timer(STAGE_DRAW);
+            clear_all_pixel();
+            draw(canvas);
+        }
+        if (frameWriter) {
+            StageTimer timer(STAGE_WRITE);
+            frameWriter->write(canvas);
+        }
+        if (headless) return;
+        if (latencyOverlay) draw_latency_overlay(canvas);
+        show();
+        int key = cv::waitKey(1);   // xử lý GUI
+        if (key >= 0) lastKey.store(key);
+        return;
+    }
+
+    cv::Mat& target = buffers[backIndex];
+    {
+        StageTimer timer(STAGE_DRAW);
+        target.setTo(cv::Scalar(0, 0, 0));
+        draw(target);
+    }
+    if (frameWriter) {
+        StageTimer timer(STAGE_WRITE);
+        frameWriter->write(target);
+    }
+    if (latencyOverlay) draw_latency_overlay(target);
+
+    // dua buffer vua ve len cho hien thi, lay lai buffer cu (chua hien thi hoac da hien thi xong)
+    int prev = readyState.exchange(backIndex | VIEWER_FRESH_BIT, std::memory_order_acq_rel);
+    if (prev & VIEWER_FRESH_BIT) skippedFrames.fetch_add(1, std::memory_order_relaxed);
+    backIndex = prev & VIEWER_INDEX_MASK;
+}
+
+void Lidar2DViewer::publish(const PointCloudSoA& cloud,
+                            float scale,
+                            const cv::Scalar& pointColor,
+                            int pointSize)
+{
+    publish_with([&](cv::Mat& target) {
+        draw_cloud(target, cloud, scale, pointColor, pointSize);
+    });
+}
+
+void Lidar2DViewer::publish(const RasterBuffer& raster, const cv::Scalar& pointColor)
+{
+    publish_with([&](cv::Mat& target) {
+        draw_raster(target, raster, pointColor);
+    });
+}
+
+void Lidar2DViewer::draw_raster(cv::Mat& target, const RasterBuffer& raster, const cv::Scalar& pointColor)
+{
+    const int rows = std::min(target.rows, raster.height());
+    const int cols = std::min(target.cols, raster.width());
+    const uint16_t* hits = raster.data();
+
+    // do sang theo so diem: 1 diem ~45%, tu 4 diem tro len 100%
+    uint8_t shade[5][3];
+    for (int h = 0; h <= 4; h++) {
+        double k = h == 0 ? 0.0 : 0.25 + 0.1875 * h;
+        for (int c = 0; c < 3; c++) shade[h][c] = cv::saturate_cast<uint8_t>(pointColor[c] * k);
+    }
+
+    for (int y = 0; y < rows; y++) {
+        const uint16_t* row = hits + static_cast<size_t>(y) * raster.width();
+        uint8_t* dst = target.ptr<uint8_t>(y);
+        for (int x = 0; x < cols; x++) {
+            if (row[x] == 0) continue;
+            const uint8_t* c = shade[std::min<int>(row[x], 4)];
+            dst[3 * x + 0] = c[0];
+            dst[3 * x + 1] = c[1];
+            dst[3 * x + 2] = c[2];
+        }
+    }
+}
+
+// p50 / p99 / max moi stage; so lieu tinh lai toi da 1 lan moi VIEWER_OVERLAY_REFRESH_NS
+void Lidar2DViewer::draw_latency_overlay(cv::Mat& target)
+{
+    const int64_t now = latency_now_ns();
+    if (now - overlayRefreshNs >= VIEWER_OVERLAY_REFRESH_NS) {
+        overlayRefreshNs = now;
+        overlayLines.clear();
+        LatencyRegistry& registry = LatencyRegistry::instance();
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            LatencySummary l = registry.summary(static_cast<PipelineStage>(s));
+            if (l.samples == 0) continue;
+            char line[96];
+            std::snprintf(line, sizeof(line), "%-8s p50 %8.1f  p99 %8.1f  max %8.1f us",
+                          stage_name(static_cast<PipelineStage>(s)), l.p50_ns * 1e-3, l.p99_ns * 1e-3, l.max_ns * 1e-3);
+            overlayLines.push_back(line);
+        }
+    }
+    int y = 18;
+    for (const auto& line : overlayLines) {
+        cv::putText(target, line, cv::Point(8, y), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(200, 200, 200), 1, cv::LINE_8);
+        y += 16;
+    }
+}
+
+void Lidar2DViewer::render_loop() {
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / renderFps));
+
+    cv::namedWindow(windowName, cv::WINDOW_AUTOSIZE);
+    auto next = clock::now();
+    while (rendering.load(std::memory_order_acquire)) {
+        if (readyState.load(std::memory_order_acquire) & VIEWER_FRESH_BIT) {
+            int prev = readyState.exchange(frontIndex, std::memory_order_acq_rel);
+            frontIndex = prev & VIEWER_INDEX_MASK;
+            StageTimer timer(STAGE_IMSHOW);
+            cv::imshow(windowName, buffers[frontIndex]);
+            timer.stop();
+            presentedFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // waitKey vua xu ly su kien GUI vua giu nhip; neu bi tre thi khong bu frame
+        next += period;
+        auto now = clock::now();
+        if (next < now) next = now;
+        double wait_ms = std::chrono::duration<double, std::milli>(next - now).count();
+        int key = cv::waitKey(std::max(1, static_cast<int>(std::ceil(wait_ms))));
+        if (key >= 0) lastKey.store(key);
+    }
+    cv::destroyWindow(windowName);
+}
+
 void Lidar2DViewer::close() {
+    stop_render();
     if (isWindowCreated) {
         cv::destroyWindow(windowName);
         isWindowCreated = false;
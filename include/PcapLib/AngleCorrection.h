@@ -0,0 +1,268 @@
+#pragma once
+//==============================================
+// Per-unit laser angle calibration (Hesai angle-correction CSV)
+// Every Pandar64 ships with its own elevation / azimuth offset per laser,
+// as a CSV "Laser id,Elevation,Azimuth" with one row per laser (deg). The
+// file is validated and turned into the per-laser tables of the decode path
+// (cos(elev)cos(off), cos(elev)sin(off), sin(elev)) once, at load time.
+// CalibrationStore holds the current tables behind a shared_ptr swapped
+// atomically: reload() during a live session never blocks the parsers, each
+// parser picks the new tables up before its next packet.
+//==============================================
+#ifndef ANGLE_CORRECTION_H
+#define ANGLE_CORRECTION_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+
+#define CALIBRATION_LASERS 64            // table capacity (largest supported model)
+
+struct AngleCorrection {
+    int lasers {CALIBRATION_LASERS};        // rows in use (Pandar40P: 40, XT32: 32, VLP-16: 16)
+    float elevation[CALIBRATION_LASERS];    // deg
+    float azimuth[CALIBRATION_LASERS];      // horizontal offset from the block azimuth (deg)
+
+    // derived decode tables (see Pandar64Parser)
+    alignas(32) float xy_cos[CALIBRATION_LASERS];
+    alignas(32) float xy_sin[CALIBRATION_LASERS];
+    alignas(32) float sin_elev[CALIBRATION_LASERS];
+
+    std::string source;                     // file name, or "built-in"
+
+    void derive() {
+        for (int l = 0; l < CALIBRATION_LASERS; l++) {
+            double elev = elevation[l] * M_PI / 180.0;
+            double off = azimuth[l] * M_PI / 180.0;
+            xy_cos[l] = static_cast<float>(std::cos(elev) * std::cos(off));
+            xy_sin[l] = static_cast<float>(std::cos(elev) * std::sin(off));
+            sin_elev[l] = static_cast<float>(std::sin(elev));
+        }
+    }
+
+    /**
+     * Bang goc mac dinh (truoc day hardcode trong parser).
+     * Bang elevation chi co 63 gia tri: laser 64 khong co trong nguon goc va la 0 do.
+     * Giu nguyen de ket qua khong doi; dung file calibration cua tung sensor khi co.
+     */
+    static const AngleCorrection& pandar64_default() {
+        static const AngleCorrection table = [] {
+            AngleCorrection c;
+            const float elev[CALIBRATION_LASERS] = {
+                14.882f, 11.032f, 8.059f, 5.057f, 3.04f, 1.854f, 0.686f, 0.514f,
+                0.348f, 0.177f, 0.01f, -0.157f, -0.324f, -0.491f, -0.658f, -0.825f,
+                -0.992f, -1.159f, -1.326f, -1.493f, -1.660f, -1.827f, -1.994f, -2.161f,
+                -2.328f, -2.495f, -2.662f, -2.829f, -2.996f, -3.163f, -3.330f, -3.497f,
+                -3.664f, -3.831f, -3.998f, -4.165f, -4.332f, -4.499f, -4.666f, -4.833f,
+                -5.000f, -5.167f, -5.334f, -5.501f, -5.668f, -5.835f, -6.002f, -6.169f,
+                -6.336f, -6.503f, -6.670f, -6.837f, -7.004f, -7.171f, -8.233f, -9.234f,
+                -10.059f, -11.206f, -12.18f, -13.148f, -14.104f, -18.889f, -24.897f
+                // laser 64: missing
+            };
+            const float az[CALIBRATION_LASERS] = {
+                -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, 3.125f,
+                5.208f, -5.208f, -3.125f, -1.042f, 1.042f, 3.125f, 5.208f, -5.208f,
+                -3.125f, -1.042f, 1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f,
+                1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f, -1.042f, -1.042f,
+                -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f,
+                -3.125f, -1.042f, 1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f,
+                1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f, -1.042f, -1.042f,
+                -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f
+            };
+            std::memcpy(c.elevation, elev, sizeof(elev));
+            std::memcpy(c.azimuth, az, sizeof(az));
+            c.source = "built-in";
+            c.derive();
+            return c;
+        }();
+        return table;
+    }
+
+    /**
+     * Doc file CSV "Laser id,Elevation,Azimuth" (dong tieu de tuy chon, laser id 1..N, N <= 64).
+     * Moi laser phai co dung 1 dong; loi -> false, khong thay doi gi.
+     * @param expected_lasers So laser cua model sensor (0 = chua biet, N bat ky).
+     */
+    bool load_csv(const std::string& path, int expected_lasers = 0) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Calibration: cannot open " << path << std::endl;
+            return false;
+        }
+        float elev[CALIBRATION_LASERS] = {};
+        float az[CALIBRATION_LASERS] = {};
+        bool seen[CALIBRATION_LASERS] = {};
+        int rows = 0;
+        int max_id = 0;
+        int line_no = 0;
+        std::string line;
+        while (std::getline(in, line)) {
+            line_no++;
+            size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') continue;
+
+            int id;
+            float e, a;
+            char extra;
+            int n = std::sscanf(line.c_str() + first, "%d , %f , %f %c", &id, &e, &a, &extra);
+            if (n < 3) {
+                if (rows == 0 && !(line[first] >= '0' && line[first] <= '9')) continue;   // header
+                std::cerr << "Calibration " << path << ":" << line_no << ": expected 'id,elevation,azimuth'" << std::endl;
+                return false;
+            }
+            if (n == 4 && extra != ',') {   // further columns are ignored
+                std::cerr << "Calibration " << path << ":" << line_no << ": trailing data" << std::endl;
+                return false;
+            }
+            if (id < 1 || id > CALIBRATION_LASERS) {
+                std::cerr << "Calibration " << path << ":" << line_no << ": laser id " << id
+                          << " outside 1.." << CALIBRATION_LASERS << std::endl;
+                return false;
+            }
+            if (seen[id - 1]) {
+                std::cerr << "Calibration " << path << ":" << line_no << ": laser " << id << " listed twice" << std::endl;
+                return false;
+            }
+            if (!std::isfinite(e) || !std::isfinite(a) || std::fabs(e) > 90.0f || std::fabs(a) > 180.0f) {
+                std::cerr << "Calibration " << path << ":" << line_no << ": angle out of range" << std::endl;
+                return false;
+            }
+            seen[id - 1] = true;
+            elev[id - 1] = e;
+            az[id - 1] = a;
+            rows++;
+            max_id = std::max(max_id, id);
+        }
+        if (rows == 0 || rows != max_id) {
+            std::cerr << "Calibration " << path << ": " << rows << " lasers, ids must be 1.." << max_id
+                      << " without gaps" << std::endl;
+            return false;
+        }
+        if (expected_lasers > 0 && rows != expected_lasers) {
+            std::cerr << "Calibration " << path << ": " << rows << " lasers, the sensor model has "
+                      << expected_lasers << std::endl;
+            return false;
+        }
+        lasers = rows;
+        std::memcpy(elevation, elev, sizeof(elev));
+        std::memcpy(azimuth, az, sizeof(az));
+        source = path;
+        derive();
+        return true;
+    }
+};
+
+// Current calibration of one sensor, replaceable while parsers run
+class CalibrationStore {
+private:
+    std::shared_ptr<const AngleCorrection> current;   // std::atomic_load / atomic_store only
+    std::atomic<uint64_t> generation_count {0};
+    std::string path;
+    int model_lasers_count {0};                       // laser count of the stream's model, 0 = not known yet
+    std::mutex reload_mtx;                            // serialises load() / reload() / require_lasers()
+    std::atomic<bool> mismatch {false};
+
+    static void on_signal(int) {
+        reload_flag().store(true, std::memory_order_relaxed);
+    }
+
+public:
+    CalibrationStore() : current(std::make_shared<const AngleCorrection>(AngleCorrection::pandar64_default())) {}
+
+    CalibrationStore(const CalibrationStore&) = delete;
+    CalibrationStore& operator=(const CalibrationStore&) = delete;
+
+    // Load and publish a calibration file; on error the current tables stay
+    bool load(const std::string& file) {
+        std::lock_guard<std::mutex> lock(reload_mtx);
+        std::shared_ptr<AngleCorrection> fresh = std::make_shared<AngleCorrection>();
+        if (!fresh->load_csv(file, model_lasers_count)) return false;
+        path = file;
+        std::atomic_store(&current, std::shared_ptr<const AngleCorrection>(fresh));
+        generation_count.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    // Read the file given to load() again (e.g. after the unit was recalibrated)
+    bool reload() {
+        std::string file;
+        {
+            std::lock_guard<std::mutex> lock(reload_mtx);
+            file = path;
+        }
+        if (file.empty()) return false;
+        if (!load(file)) {
+            std::cerr << "[WARN] calibration reload failed, keeping " << get()->source << std::endl;
+            return false;
+        }
+        std::cerr << "[INFO] calibration reloaded: " << file << std::endl;
+        return true;
+    }
+
+    inline std::shared_ptr<const AngleCorrection> get() const {
+        return std::atomic_load(&current);
+    }
+
+    // Changes on every successful load(); parsers compare it before each packet
+    inline uint64_t generation() const {
+        return generation_count.load(std::memory_order_acquire);
+    }
+
+    inline bool has_file() const {
+        return generation() > 0;
+    }
+
+    /**
+     * Model cua stream da biet (--model, hoac parser vua nhan dien xong): file dang dung
+     * va moi file load() / reload() sau nay phai co dung `lasers` laser.
+     * File dang dung sai so laser la loi cung (khong quay ve bang built-in): in 1 lan,
+     * rejected() = true de vong xu ly dung lai. Tra ve false neu file sai.
+     */
+    bool require_lasers(int lasers, const char* model) {
+        std::shared_ptr<const AngleCorrection> c;
+        {
+            std::lock_guard<std::mutex> lock(reload_mtx);
+            model_lasers_count = lasers;
+            if (generation() == 0) return true;   // built-in tables, set by the parser itself
+            c = get();
+        }
+        if (c->lasers == lasers) return true;
+        if (!mismatch.exchange(true)) {
+            std::cerr << "[ERROR] calibration " << c->source << " has " << c->lasers << " lasers, "
+                      << model << " has " << lasers << std::endl;
+        }
+        return false;
+    }
+
+    // A parser found the calibration file does not fit its stream's model
+    inline bool rejected() const {
+        return mismatch.load(std::memory_order_relaxed);
+    }
+
+    // Flag set by the reload signal, polled by the processing loop
+    static std::atomic<bool>& reload_flag() {
+        static std::atomic<bool> flag {false};
+        return flag;
+    }
+
+    // Reload on `sig` (default SIGHUP)
+    static void install_reload_signal(int sig = SIGHUP) {
+        reload_flag();   // construct before the handler can run
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = &CalibrationStore::on_signal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(sig, &sa, nullptr);
+    }
+};
+
+#endif // ANGLE_CORRECTION_H
@@ -0,0 +1,385 @@
+#pragma once
+//==============================================
+// Motion de-skew with an external pose stream
+// A revolution takes ~100 ms; on a moving vehicle every point is measured
+// from a different pose. Each point is moved into the sensor frame at the
+// end of the revolution: p' = T(t_end)^-1 * T(t_point) * p. Poses are
+// interpolated once per azimuth sector (DESKEW_SECTORS per turn, at the
+// sector's mid time), not per point, and the sector's 3x4 transform is
+// applied to the x/y/z columns with SIMD. Scalar, SSE4.1 and AVX2 give
+// bit-identical results (same operation order, no FMA).
+//
+// Pose file: CSV "t,x,y,z,qx,qy,qz,qw" (s, m, unit quaternion, pose of the
+// sensor in a world frame) or the same 8 values as little-endian doubles
+// per record (".bin").
+//==============================================
+#ifndef DESKEW_H
+#define DESKEW_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "Pandar64_simd.h"
+#include "PointCloudSoA.h"
+#include "FrameAssembler.h"
+
+#define DESKEW_SECTORS   64         // azimuth sectors per revolution, one pose each
+#define POSE_MAX_GAP_S   0.5        // poses further apart are not interpolated
+
+struct Pose {
+    double t {0.0};
+    double p[3] {0.0, 0.0, 0.0};
+    double q[4] {0.0, 0.0, 0.0, 1.0};   // x, y, z, w
+
+    // row-major rotation matrix of q
+    void rotation(double r[9]) const {
+        const double x = q[0], y = q[1], z = q[2], w = q[3];
+        r[0] = 1 - 2 * (y * y + z * z); r[1] = 2 * (x * y - z * w);     r[2] = 2 * (x * z + y * w);
+        r[3] = 2 * (x * y + z * w);     r[4] = 1 - 2 * (x * x + z * z); r[5] = 2 * (y * z - x * w);
+        r[6] = 2 * (x * z - y * w);     r[7] = 2 * (y * z + x * w);     r[8] = 1 - 2 * (x * x + y * y);
+    }
+};
+
+class PoseStream {
+private:
+    std::vector<Pose> poses;
+
+    // normalise and check one record; msg = reason on error
+    static bool check(Pose& p, const Pose* prev, const char*& msg) {
+        for (double v : { p.t, p.p[0], p.p[1], p.p[2], p.q[0], p.q[1], p.q[2], p.q[3] }) {
+            if (!std::isfinite(v)) {
+                msg = "non-finite value";
+                return false;
+            }
+        }
+        const double norm = std::sqrt(p.q[0] * p.q[0] + p.q[1] * p.q[1] + p.q[2] * p.q[2] + p.q[3] * p.q[3]);
+        if (norm < 1e-6) {
+            msg = "zero quaternion";
+            return false;
+        }
+        for (double& c : p.q) c /= norm;
+        if (prev && !(p.t > prev->t)) {
+            msg = "time not increasing";
+            return false;
+        }
+        return true;
+    }
+
+public:
+    // ".bin": binary records, otherwise CSV
+    bool load(const std::string& path) {
+        const bool binary = path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+        return binary ? load_binary(path) : load_csv(path);
+    }
+
+    /**
+     * Doc CSV "t,x,y,z,qx,qy,qz,qw" (dong tieu de / '#' bo qua). Loi -> false, khong thay doi gi.
+     */
+    bool load_csv(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Poses: cannot open " << path << std::endl;
+            return false;
+        }
+        std::vector<Pose> fresh;
+        std::string line;
+        int line_no = 0;
+        while (std::getline(in, line)) {
+            line_no++;
+            size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') continue;
+
+            Pose p;
+            int n = std::sscanf(line.c_str() + first, "%lf , %lf , %lf , %lf , %lf , %lf , %lf , %lf",
+                                &p.t, &p.p[0], &p.p[1], &p.p[2], &p.q[0], &p.q[1], &p.q[2], &p.q[3]);
+            if (n < 8) {
+                if (fresh.empty() && n <= 0) continue;   // header
+                std::cerr << "Poses " << path << ":" << line_no << ": expected 't,x,y,z,qx,qy,qz,qw'" << std::endl;
+                return false;
+            }
+            const char* msg = nullptr;
+            if (!check(p, fresh.empty() ? nullptr : &fresh.back(), msg)) {
+                std::cerr << "Poses " << path << ":" << line_no << ": " << msg << std::endl;
+                return false;
+            }
+            fresh.push_back(p);
+        }
+        return publish(path, fresh);
+    }
+
+    // 8 little-endian doubles per record, same order as the CSV
+    bool load_binary(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Poses: cannot open " << path << std::endl;
+            return false;
+        }
+        std::vector<Pose> fresh;
+        double v[8];
+        while (in.read(reinterpret_cast<char*>(v), sizeof(v))) {
+            Pose p;
+            p.t = v[0];
+            std::copy(v + 1, v + 4, p.p);
+            std::copy(v + 4, v + 8, p.q);
+            const char* msg = nullptr;
+            if (!check(p, fresh.empty() ? nullptr : &fresh.back(), msg)) {
+                std::cerr << "Poses " << path << ": record " << fresh.size() << ": " << msg << std::endl;
+                return false;
+            }
+            fresh.push_back(p);
+        }
+        if (in.gcount() != 0) {
+            std::cerr << "Poses " << path << ": trailing " << in.gcount() << " bytes" << std::endl;
+            return false;
+        }
+        return publish(path, fresh);
+    }
+
+    // Append one pose (live feed / synthetic stream); false if invalid or out of order
+    bool add(Pose p) {
+        const char* msg = nullptr;
+        if (!check(p, poses.empty() ? nullptr : &poses.back(), msg)) {
+            std::cerr << "[WARN] pose at " << p.t << " s rejected: " << msg << std::endl;
+            return false;
+        }
+        poses.push_back(p);
+        return true;
+    }
+
+    inline size_t size() const { return poses.size(); }
+    inline double begin_time() const { return poses.empty() ? 0.0 : poses.front().t; }
+    inline double end_time() const { return poses.empty() ? 0.0 : poses.back().t; }
+
+    /**
+     * Pose tai thoi diem t: noi suy tuyen tinh vi tri, slerp quaternion.
+     * false neu t nam ngoai dong pose hoac 2 pose ke nhau cach qua POSE_MAX_GAP_S.
+     */
+    bool at(double t, Pose& out) const {
+        if (poses.empty() || t < poses.front().t || t > poses.back().t) return false;
+        auto it = std::upper_bound(poses.begin(), poses.end(), t,
+                                   [](double v, const Pose& p) { return v < p.t; });
+        if (it == poses.end()) {
+            out = poses.back();
+            return true;
+        }
+        const Pose& b = *it;
+        const Pose& a = *(it - 1);
+        if (b.t - a.t > POSE_MAX_GAP_S) return false;
+
+        const double u = (t - a.t) / (b.t - a.t);
+        out.t = t;
+        for (int k = 0; k < 3; k++) out.p[k] = a.p[k] + u * (b.p[k] - a.p[k]);
+
+        double dot = a.q[0] * b.q[0] + a.q[1] * b.q[1] + a.q[2] * b.q[2] + a.q[3] * b.q[3];
+        const double sign = dot < 0 ? -1.0 : 1.0;   // shortest arc
+        dot *= sign;
+        double wa = 1.0 - u, wb = u;
+        if (dot < 0.9995) {
+            const double theta = std::acos(dot);
+            const double s = std::sin(theta);
+            wa = std::sin((1.0 - u) * theta) / s;
+            wb = std::sin(u * theta) / s;
+        }
+        double norm = 0.0;
+        for (int k = 0; k < 4; k++) {
+            out.q[k] = wa * a.q[k] + wb * sign * b.q[k];
+            norm += out.q[k] * out.q[k];
+        }
+        norm = std::sqrt(norm);
+        for (double& c : out.q) c /= norm;
+        return true;
+    }
+
+private:
+    bool publish(const std::string& path, std::vector<Pose>& fresh) {
+        if (fresh.size() < 2) {
+            std::cerr << "Poses " << path << ": need at least 2 poses" << std::endl;
+            return false;
+        }
+        poses.swap(fresh);
+        std::cerr << "[INFO] poses: " << poses.size() << " from " << path << ", "
+                  << end_time() - begin_time() << " s" << std::endl;
+        return true;
+    }
+};
+
+typedef void (*TransformFn)(float* x, float* y, float* z, size_t n, const float* m);
+
+//==========================================================================
+// In-place 3x4 transform (row-major [R | t]) of n points
+//==========================================================================
+inline void transform_points_scalar(float* x, float* y, float* z, size_t n, const float* m) {
+    for (size_t i = 0; i < n; i++) {
+        const float px = x[i], py = y[i], pz = z[i];
+        x[i] = ((m[0] * px + m[1] * py) + m[2] * pz) + m[3];
+        y[i] = ((m[4] * px + m[5] * py) + m[6] * pz) + m[7];
+        z[i] = ((m[8] * px + m[9] * py) + m[10] * pz) + m[11];
+    }
+}
+
+#ifdef PANDAR64_X86
+
+__attribute__((target("sse4.1")))
+inline void transform_points_sse41(float* x, float* y, float* z, size_t n, const float* m) {
+    __m128 r[12];
+    for (int k = 0; k < 12; k++) r[k] = _mm_set1_ps(m[k]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], px), _mm_mul_ps(r[1], py)),
+                                                   _mm_mul_ps(r[2], pz)), r[3]));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[4], px), _mm_mul_ps(r[5], py)),
+                                                   _mm_mul_ps(r[6], pz)), r[7]));
+        _mm_storeu_ps(z + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[8], px), _mm_mul_ps(r[9], py)),
+                                                   _mm_mul_ps(r[10], pz)), r[11]));
+    }
+    transform_points_scalar(x + i, y + i, z + i, n - i, m);
+}
+
+__attribute__((target("avx2")))
+inline void transform_points_avx2(float* x, float* y, float* z, size_t n, const float* m) {
+    __m256 r[12];
+    for (int k = 0; k < 12; k++) r[k] = _mm256_set1_ps(m[k]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i);
+        const __m256 py = _mm256_loadu_ps(y + i);
+        const __m256 pz = _mm256_loadu_ps(z + i);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], px),
+                                                                          _mm256_mul_ps(r[1], py)),
+                                                            _mm256_mul_ps(r[2], pz)), r[3]));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[4], px),
+                                                                          _mm256_mul_ps(r[5], py)),
+                                                            _mm256_mul_ps(r[6], pz)), r[7]));
+        _mm256_storeu_ps(z + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[8], px),
+                                                                          _mm256_mul_ps(r[9], py)),
+                                                            _mm256_mul_ps(r[10], pz)), r[11]));
+    }
+    transform_points_scalar(x + i, y + i, z + i, n - i, m);
+}
+
+#endif // PANDAR64_X86
+
+inline TransformFn select_transform(SimdLevel level) {
+#ifdef PANDAR64_X86
+    if (level == SIMD_AVX2) return transform_points_avx2;
+    if (level == SIMD_SSE41) return transform_points_sse41;
+#endif
+    (void)level;
+    return transform_points_scalar;
+}
+
+class MotionDeskew {
+private:
+    std::shared_ptr<const PoseStream> poses;
+    SimdLevel simd_level {SIMD_SCALAR};
+    TransformFn transform {transform_points_scalar};
+    bool sensor_clock {false};          // pose times on the sensor clock (packet tail)
+
+    uint64_t frame_count {0};
+    uint64_t skipped_count {0};         // frames outside the pose stream
+    uint64_t sector_miss_count {0};     // sectors left as measured (pose gap)
+    double total_sec {0.0};
+    double max_sec {0.0};
+
+public:
+    explicit MotionDeskew(std::shared_ptr<const PoseStream> pose_stream, SimdLevel level = detect_simd_level())
+        : poses(std::move(pose_stream)) {
+        set_simd_level(level);
+    }
+
+    void set_simd_level(SimdLevel level) {
+        simd_level = level;
+        transform = select_transform(level);
+    }
+
+    // true: pose times are sensor time (LidarFrame::sensor_*_time), false: capture time
+    inline void set_sensor_clock(bool on) {
+        sensor_clock = on;
+    }
+
+    /**
+     * Dua moi diem cua frame ve he toa do sensor tai end_time cua frame (tai cho).
+     * false (frame giu nguyen) neu khong co pose cho ca vong quay.
+     */
+    bool apply(LidarFrame& frame) {
+        auto start = std::chrono::steady_clock::now();
+        PointCloudSoA& c = frame.cloud;
+        const size_t n = c.size();
+        if (n == 0) return false;
+
+        // capture clock -> pose clock
+        double offset = 0.0;
+        if (sensor_clock) {
+            if (frame.sensor_end_time == 0.0) {
+                skipped_count++;
+                return false;
+            }
+            offset = frame.sensor_end_time - frame.end_time;
+        }
+        Pose end, begin;
+        if (!poses->at(frame.end_time + offset, end) || !poses->at(frame.start_time + offset, begin)) {
+            skipped_count++;
+            return false;
+        }
+        double re[9];
+        end.rotation(re);
+
+        const uint16_t* az = c.azimuth.data();
+        const double* ts = c.timestamp.data();
+        float* px = c.x.data();
+        float* py = c.y.data();
+        float* pz = c.z.data();
+        size_t first = 0;
+        while (first < n) {
+            // run of points in one sector: [lo, hi) in 0.01 deg
+            const int sector = az[first] * DESKEW_SECTORS / FULL_TURN_CDEG;
+            const int lo = (sector * FULL_TURN_CDEG + DESKEW_SECTORS - 1) / DESKEW_SECTORS;
+            const int hi = ((sector + 1) * FULL_TURN_CDEG + DESKEW_SECTORS - 1) / DESKEW_SECTORS;
+            size_t last = first + 1;
+            while (last < n && az[last] >= lo && az[last] < hi) last++;
+
+            Pose p;
+            if (!poses->at(0.5 * (ts[first] + ts[last - 1]) + offset, p)) {
+                sector_miss_count++;
+                first = last;
+                continue;
+            }
+            // T(end)^-1 * T(p): R = Re^T * Rp, t = Re^T * (tp - te)
+            double rp[9];
+            p.rotation(rp);
+            float m[12];
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    m[i * 4 + j] = static_cast<float>(re[i] * rp[j] + re[3 + i] * rp[3 + j] + re[6 + i] * rp[6 + j]);
+                }
+                m[i * 4 + 3] = static_cast<float>(re[i] * (p.p[0] - end.p[0]) + re[3 + i] * (p.p[1] - end.p[1]) +
+                                                  re[6 + i] * (p.p[2] - end.p[2]));
+            }
+            transform(px + first, py + first, pz + first, last - first, m);
+            first = last;
+        }
+
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        total_sec += sec;
+        max_sec = std::max(max_sec, sec);
+        frame_count++;
+        return true;
+    }
+
+    inline uint64_t frames() const { return frame_count; }
+    inline uint64_t skipped() const { return skipped_count; }
+    inline uint64_t sector_misses() const { return sector_miss_count; }
+    inline double mean_seconds() const { return frame_count ? total_sec / frame_count : 0.0; }
+    inline double max_seconds() const { return max_sec; }
+};
+
+#endif // DESKEW_H
@@ -0,0 +1,318 @@
+#pragma once
+//==============================================
+// Flight recorder: the last N seconds of raw packets, dumped on trigger
+// The capture thread copies every packet into the active ring (fixed-size
+// slots, oldest overwritten). On a trigger (SIGUSR1, key press, packet gap
+// rule or trigger()) it swaps in the spare ring and hands the full one to
+// a dump thread, which writes it with pcap_dump. The capture thread never
+// waits for disk: if the previous dump is still running, the trigger stays
+// pending until the spare ring is free again. poll() services triggers
+// while no packet arrives (sensor silent), stop() dumps one still pending.
+//==============================================
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <cmath>
+#include <csignal>
+#include "PCAP_capture.h"
+
+#define FLIGHT_PACKET_RATE 3600.0  // packet/s budgeted per ring (Pandar64 dual return; single ~ 1800)
+#define FLIGHT_RATE_MARGIN 1.2      // headroom over FLIGHT_PACKET_RATE (rpm drift, other traffic)
+#define FLIGHT_SLOT_SIZE   1600     // bytes per slot, longer packets are truncated
+#define FLIGHT_WINDOW_S    10.0     // seconds kept before the trigger
+
+class FlightRecorder {
+private:
+    struct Ring {
+        std::vector<PCAP_Header> headers;
+        std::vector<u_char> data;
+        uint64_t written {0};           // packets ever recorded into this ring
+    };
+
+    const size_t slot_count;
+    const size_t slot_size;
+    double window_s;
+    Ring rings[2];
+    int active {0};                     // capture thread only
+    bool deferring {false};             // capture thread only: pending trigger already counted
+
+    // capture thread -> dump thread
+    std::mutex mtx;
+    std::condition_variable cv_dump;
+    int dump_ring {-1};
+    bool stopping {false};
+    std::thread dumper;
+    std::atomic<bool> spare_free {true};
+    std::atomic<bool> pending {false};
+
+    std::string out_dir;
+    int link_type {DLT_EN10MB};
+    double gap_trigger_s {0.0};
+    double last_stamp {-1.0};
+    int64_t last_arrival_ns {-1};       // capture thread only: steady_clock time of the last packet
+    bool silence_triggered {false};     // capture thread only: gap rule already fired by poll()
+    uint64_t dump_seq {0};              // dump thread only
+    bool short_warned {false};          // dump thread only
+
+    std::atomic<uint64_t> trigger_count {0};
+    std::atomic<uint64_t> deferred_count {0};
+    std::atomic<uint64_t> dump_count {0};
+    std::atomic<uint64_t> truncated_count {0};
+
+    static inline double stamp_of(const PCAP_Header& h) {
+        return h.timestamp_second + h.timestamp_microsecond * 1e-6;
+    }
+
+    static inline int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // signal flag -> trigger; flush if a trigger is pending
+    inline void service() {
+        if (signal_flag().load(std::memory_order_relaxed) && signal_flag().exchange(false)) trigger();
+        if (pending.load(std::memory_order_relaxed)) flush_active();
+    }
+
+    // hand the active ring to the dump thread and continue in the spare one
+    void flush_active() {
+        if (!spare_free.load(std::memory_order_acquire)) {
+            if (!deferring) deferred_count.fetch_add(1, std::memory_order_relaxed);
+            deferring = true;
+            return;   // stays pending
+        }
+        deferring = false;
+        pending.store(false, std::memory_order_relaxed);
+        spare_free.store(false, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            dump_ring = active;
+        }
+        cv_dump.notify_one();
+        active ^= 1;
+        rings[active].written = 0;
+        trigger_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void dump_loop() {
+        while (true) {
+            int idx;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_dump.wait(lock, [&] { return stopping || dump_ring >= 0; });
+                if (dump_ring < 0) return;
+                idx = dump_ring;
+                dump_ring = -1;
+            }
+            write_ring(rings[idx]);
+            spare_free.store(true, std::memory_order_release);
+        }
+    }
+
+    void write_ring(const Ring& ring) {
+        const uint64_t n = std::min<uint64_t>(ring.written, slot_count);
+        if (n == 0) return;
+        const uint64_t end = ring.written;
+        uint64_t first = end - n;
+
+        // only the last window_s seconds before the newest packet
+        const double newest = stamp_of(ring.headers[(end - 1) % slot_count]);
+        while (first < end - 1 && stamp_of(ring.headers[first % slot_count]) < newest - window_s) first++;
+
+        // ring wrapped before the window was full: the stream is faster than the ring was sized for
+        const double kept_s = newest - stamp_of(ring.headers[first % slot_count]);
+        if (ring.written > slot_count && first == end - n && kept_s < window_s * 0.99 && !short_warned) {
+            std::cerr << "[WARN] flight recorder: " << slot_count << " slots hold only " << kept_s
+                      << " s of the " << window_s << " s window; raise --record-slots" << std::endl;
+            short_warned = true;
+        }
+
+        char name[64];
+        std::time_t now = std::time(nullptr);
+        std::tm tm_now;
+        localtime_r(&now, &tm_now);
+        std::strftime(name, sizeof(name), "flight_%Y%m%d_%H%M%S", &tm_now);
+        std::string path = out_dir + "/" + name + "_" + std::to_string(dump_seq++) + ".pcap";
+
+        pcap_t* dead = pcap_open_dead(link_type, SNAP_LEN);
+        pcap_dumper_t* dump = dead ? pcap_dump_open(dead, path.c_str()) : nullptr;
+        if (!dump) {
+            std::cerr << "[WARN] flight recorder: cannot write " << path
+                      << (dead ? std::string(": ") + pcap_geterr(dead) : std::string()) << std::endl;
+            if (dead) pcap_close(dead);
+            return;
+        }
+        for (uint64_t k = first; k < end; k++) {
+            const PCAP_Header& h = ring.headers[k % slot_count];
+            pcap_pkthdr ph;
+            ph.ts.tv_sec = h.timestamp_second;
+            ph.ts.tv_usec = h.timestamp_microsecond;
+            ph.caplen = h.capture_length;
+            ph.len = h.length;
+            pcap_dump(reinterpret_cast<u_char*>(dump), &ph, ring.data.data() + (k % slot_count) * slot_size);
+        }
+        pcap_dump_close(dump);
+        pcap_close(dead);
+        dump_count.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "[INFO] flight recorder: " << (end - first) << " packets ("
+                  << kept_s << " s) -> " << path << std::endl;
+    }
+
+    static void on_signal(int) {
+        signal_flag().store(true, std::memory_order_relaxed);
+    }
+
+public:
+    // Slots needed to hold `seconds` of a stream of `packet_rate` packet/s, with FLIGHT_RATE_MARGIN
+    static inline size_t slots_for(double seconds, double packet_rate = FLIGHT_PACKET_RATE) {
+        return static_cast<size_t>(std::ceil(std::max(seconds, 0.0) * packet_rate * FLIGHT_RATE_MARGIN));
+    }
+
+    /**
+     * @param slots So packet toi da moi ring (2 ring duoc cap phat); 0 = slots_for(window_seconds).
+     * @param window_seconds So giay truoc trigger duoc ghi ra.
+     * Neu slots khong du cho window o FLIGHT_PACKET_RATE: canh bao ngay, va canh bao lai
+     * khi dump that su bi cat ngan.
+     */
+    explicit FlightRecorder(size_t slots = 0, double window_seconds = FLIGHT_WINDOW_S,
+                            size_t slot_bytes = FLIGHT_SLOT_SIZE)
+        : slot_count(std::max<size_t>(slots ? slots : slots_for(window_seconds), 1)),
+          slot_size(slot_bytes), window_s(window_seconds) {
+        if (slot_count < window_s * FLIGHT_PACKET_RATE) {
+            std::cerr << "[WARN] flight recorder: " << slot_count << " slots hold ~"
+                      << slot_count / FLIGHT_PACKET_RATE << " s at " << FLIGHT_PACKET_RATE
+                      << " packet/s, less than the " << window_s << " s window" << std::endl;
+        }
+        for (auto& r : rings) {
+            r.headers.resize(slot_count);
+            r.data.resize(slot_count * slot_size);
+        }
+    }
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    ~FlightRecorder() {
+        stop();
+    }
+
+    // Start the dump thread; files go to out_directory/flight_<date>_<time>_<n>.pcap
+    bool start(const std::string& out_directory, int datalink = DLT_EN10MB) {
+        if (dumper.joinable()) return true;
+        out_dir = out_directory.empty() ? "." : out_directory;
+        link_type = datalink;
+        stopping = false;
+        dumper = std::thread(&FlightRecorder::dump_loop, this);
+        return true;
+    }
+
+    /**
+     * Dung dump thread sau khi dump dang chay xong. Goi khi capture thread da dung:
+     * trigger con pending (vd. SIGUSR1 / 'r' ngay truoc khi thoat) duoc dump truoc,
+     * neu khong co trigger thi ring khong duoc ghi ra.
+     */
+    void stop() {
+        if (!dumper.joinable()) return;
+        if (signal_flag().load(std::memory_order_relaxed) && signal_flag().exchange(false)) trigger();
+        if (pending.load(std::memory_order_relaxed)) {
+            while (!spare_free.load(std::memory_order_acquire)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            flush_active();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_dump.notify_one();
+        dumper.join();
+    }
+
+    // Rule: trigger when consecutive packets are more than `seconds` apart (sensor dropout). 0 = off
+    inline void set_gap_trigger(double seconds) {
+        gap_trigger_s = seconds;
+    }
+
+    // Request a dump; any thread
+    inline void trigger() {
+        pending.store(true, std::memory_order_relaxed);
+    }
+
+    // Flag set by the signal handler, polled by record() / poll()
+    static std::atomic<bool>& signal_flag() {
+        static std::atomic<bool> flag {false};
+        return flag;
+    }
+
+    // Dump on `sig` (default SIGUSR1)
+    static void install_signal_trigger(int sig = SIGUSR1) {
+        signal_flag();   // construct before the handler can run
+        struct sigaction sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = &FlightRecorder::on_signal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(sig, &sa, nullptr);
+    }
+
+    //==========================================================================
+    // Capture thread
+    //==========================================================================
+    void record(const PCAP_PacketView& packet) {
+        Ring& ring = rings[active];
+        const size_t slot = ring.written % slot_count;
+        uint32_t caplen = packet.packet_header.capture_length;
+        if (caplen > slot_size) {
+            caplen = static_cast<uint32_t>(slot_size);
+            truncated_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        ring.headers[slot] = packet.packet_header;
+        ring.headers[slot].capture_length = caplen;
+        std::memcpy(ring.data.data() + slot * slot_size, packet.packet_data, caplen);
+        ring.written++;
+
+        const double stamp = stamp_of(packet.packet_header);
+        if (gap_trigger_s > 0) {
+            // a silence poll() already dumped is not triggered again when traffic resumes
+            if (last_stamp >= 0 && stamp - last_stamp > gap_trigger_s && !silence_triggered) trigger();
+            silence_triggered = false;
+            last_arrival_ns = now_ns();
+        }
+        last_stamp = stamp;
+
+        service();
+    }
+
+    // Call when a read returned no packet (timeout): dumps on a pending trigger even while
+    // the stream is silent, and fires the gap rule once the silence exceeds it
+    void poll() {
+        if (gap_trigger_s > 0 && last_arrival_ns >= 0 && !silence_triggered &&
+            now_ns() - last_arrival_ns > static_cast<int64_t>(gap_trigger_s * 1e9)) {
+            silence_triggered = true;
+            trigger();
+        }
+        service();
+    }
+
+    //==========================================================================
+    // Statistics
+    //==========================================================================
+    inline uint64_t triggers() const { return trigger_count.load(); }
+    // triggers that had to wait for the previous dump to finish
+    inline uint64_t deferred() const { return deferred_count.load(); }
+    inline uint64_t dumps() const { return dump_count.load(); }
+    inline uint64_t truncated() const { return truncated_count.load(); }
+};
+
+#endif // FLIGHT_RECORDER_H
@@ -0,0 +1,179 @@
+#pragma once
+//==============================================
+// Revolution (frame) assembler
+// Packets are parsed straight into the frame under construction; the block
+// azimuth column is watched for the 360 deg wrap past a configurable cut
+// angle. Points after the cut start the next frame, so every emitted frame is
+// exactly one contiguous revolution.
+//==============================================
+#ifndef FRAME_ASSEMBLER_H
+#define FRAME_ASSEMBLER_H
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "PointCloudSoA.h"
+
+#define FULL_TURN_CDEG 36000    // 360 deg in 0.01 deg azimuth units
+#define HALF_TURN_CDEG 18000
+
+struct LidarFrame {
+    PointCloudSoA cloud;
+    uint64_t frame_id {0};
+    double start_time {0.0};      // timestamp of the first point (s)
+    double end_time {0.0};        // timestamp of the last point (s)
+    double sensor_start_time {0.0};   // same points on the sensor clock (packet tail), 0 if unknown
+    double sensor_end_time {0.0};
+    size_t packet_count {0};      // packets contributing points (a split packet counts in both frames)
+};
+
+// Detects the 360 deg wrap past the cut angle in a stream of azimuths
+class AzimuthWrapDetector {
+private:
+    uint16_t cut_cdeg {0};
+    int32_t prev_dist {-1};       // distance past the cut of the last azimuth, -1 = none yet
+
+    // azimuth distance past the cut angle, in [0, 36000)
+    inline int32_t past_cut(uint16_t az) const {
+        int32_t d = static_cast<int32_t>(az) - cut_cdeg;
+        return d < 0 ? d + FULL_TURN_CDEG : d;
+    }
+
+public:
+    explicit AzimuthWrapDetector(float cut_angle_deg = 0.0f) {
+        set_cut_angle(cut_angle_deg);
+    }
+
+    void set_cut_angle(float cut_angle_deg) {
+        float a = std::fmod(cut_angle_deg, 360.0f);
+        if (a < 0) a += 360.0f;
+        cut_cdeg = static_cast<uint16_t>(std::lround(a * 100.0f) % FULL_TURN_CDEG);
+    }
+
+    // true if az (0.01 deg) starts a new revolution
+    inline bool update(uint16_t az) {
+        int32_t d = past_cut(az);
+        // wrap = large backward jump of the distance past the cut; small
+        // backward steps (jitter, repeated dual-return azimuths) are ignored
+        bool wrapped = prev_dist >= 0 && prev_dist - d > HALF_TURN_CDEG;
+        prev_dist = d;
+        return wrapped;
+    }
+
+    inline void reset() {
+        prev_dist = -1;
+    }
+};
+
+class FrameAssembler {
+private:
+    LidarFrame building;
+    LidarFrame completed;
+    AzimuthWrapDetector wrap;
+    bool synced {false};          // seen a first wrap, frames are complete revolutions
+    uint64_t next_id {0};
+    // sensor clock - capture clock, for the first point of `building` and the last packet
+    double building_offset {std::numeric_limits<double>::quiet_NaN()};
+    double last_offset {std::numeric_limits<double>::quiet_NaN()};
+
+    void finish(LidarFrame& frame, double first_offset, double end_offset) {
+        const PointCloudSoA& c = frame.cloud;
+        frame.start_time = c.empty() ? 0.0 : c.timestamp[0];
+        frame.end_time = c.empty() ? 0.0 : c.timestamp[c.size() - 1];
+        frame.sensor_start_time = c.empty() || std::isnan(first_offset) ? 0.0 : frame.start_time + first_offset;
+        frame.sensor_end_time = c.empty() || std::isnan(end_offset) ? 0.0 : frame.end_time + end_offset;
+        frame.frame_id = next_id++;
+    }
+
+public:
+    /**
+     * @param cut_angle_deg Goc cat frame (do), frame moi bat dau khi azimuth vuot qua goc nay.
+     * @param reserve_points So diem du tru cho moi frame.
+     */
+    explicit FrameAssembler(float cut_angle_deg = 0.0f, size_t reserve_points = 0) {
+        set_cut_angle(cut_angle_deg);
+        building.cloud.reserve(reserve_points);
+        completed.cloud.reserve(reserve_points);
+    }
+
+    void set_cut_angle(float cut_angle_deg) {
+        wrap.set_cut_angle(cut_angle_deg);
+    }
+
+    // Parse target: append the points of the next packet here, then call commit()
+    inline PointCloudSoA& cloud() {
+        return building.cloud;
+    }
+
+    /**
+     * Xet cac diem vua them tu chi so `first`. Tra ve true neu vua hoan thanh 1 vong quay,
+     * khi do frame() giu vong quay do cho den lan commit() tiep theo.
+     * @param clock_offset PacketTail::clock_offset cua packet (NAN: khong co gio sensor).
+     */
+    bool commit(size_t first, double clock_offset = std::numeric_limits<double>::quiet_NaN()) {
+        building.packet_count++;
+        PointCloudSoA& c = building.cloud;
+        const size_t n = c.size();
+        const uint16_t* az = c.azimuth.data();
+        const double prev_offset = last_offset;
+        last_offset = clock_offset;
+        if (first == 0) building_offset = clock_offset;
+
+        for (size_t k = first; k < n; k++) {
+            if (!wrap.update(az[k])) continue;
+
+            if (!synced) {
+                // points before the first wrap are a partial revolution: drop them
+                synced = true;
+                size_t tail = n - k;
+                completed.cloud.clear();
+                completed.cloud.append_range(c, k, tail);
+                std::swap(building.cloud, completed.cloud);
+                building.packet_count = 1;
+                building_offset = clock_offset;
+                return false;
+            }
+
+            std::swap(building, completed);
+            building.cloud.clear();
+            building.cloud.append_range(completed.cloud, k, n - k);
+            building.packet_count = 1;
+            if (k == first) completed.packet_count--;   // packet belongs wholly to the new frame
+            completed.cloud.resize(k);
+            finish(completed, building_offset, k > first ? clock_offset : prev_offset);
+            building_offset = clock_offset;
+            return true;
+        }
+        return false;
+    }
+
+    // Emit the revolution in progress (end of stream). Returns false if empty.
+    bool flush() {
+        if (building.cloud.empty()) return false;
+        std::swap(building, completed);
+        building.cloud.clear();
+        building.packet_count = 0;
+        finish(completed, building_offset, last_offset);
+        return true;
+    }
+
+    void reset() {
+        building.cloud.clear();
+        building.packet_count = 0;
+        wrap.reset();
+        synced = false;
+    }
+
+    // last completed frame
+    inline const LidarFrame& frame() const {
+        return completed;
+    }
+
+    // same, for stages that post-process it in place (de-skew) before it is used
+    inline LidarFrame& frame() {
+        return completed;
+    }
+};
+
+#endif // FRAME_ASSEMBLER_H
@@ -0,0 +1,234 @@
+#pragma once
+//==============================================
+// Background frame encoder
+// write() copies a rendered canvas into one of a few preallocated buffers and
+// returns; an encoder thread turns the queue into a PNG sequence (imwrite) or
+// a video (cv::VideoWriter). Every frame is kept: when all buffers are
+// waiting to be encoded, write() blocks until one is free.
+//==============================================
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <cstdio>
+#include <cctype>
+#include <unistd.h>
+
+#define FRAME_WRITER_QUEUE 8        // frames buffered between render and encoder
+#define FRAME_WRITER_FOURCC 'm', 'p', '4', 'v'
+#define FRAME_WRITER_DIGITS 6       // zero padding when the PNG pattern has no field width
+
+class FrameWriter {
+private:
+    enum Mode { WRITER_CLOSED, WRITER_PNG, WRITER_VIDEO };
+
+    Mode mode {WRITER_CLOSED};
+    // PNG file name: png_prefix + frame index zero-padded to png_digits + png_suffix
+    std::string png_prefix;
+    std::string png_suffix;
+    int png_digits {0};
+    cv::VideoWriter video;
+    size_t queue_frames;
+
+    std::vector<cv::Mat> buffers;
+    std::deque<size_t> free_slots;      // buffers the producer may fill
+    std::deque<size_t> pending;         // buffers waiting to be encoded, in order
+    std::mutex mtx;
+    std::condition_variable cv_pending;
+    std::condition_variable cv_free;
+    bool stopping {false};
+    std::thread encoder;
+
+    // statistics
+    uint64_t frames_queued {0};
+    uint64_t frames_done {0};
+    uint64_t frames_failed {0};
+    uint64_t producer_waits {0};        // write() found every buffer busy
+    double encode_sec {0.0};
+
+    bool start(Mode m) {
+        buffers.assign(queue_frames, cv::Mat());
+        free_slots.clear();
+        pending.clear();
+        for (size_t k = 0; k < queue_frames; k++) free_slots.push_back(k);
+        stopping = false;
+        mode = m;
+        encoder = std::thread(&FrameWriter::encoder_loop, this);
+        return true;
+    }
+
+    // "out/frame_000042.png" for index 42 and pattern "out/frame_%06llu.png"
+    std::string png_path(uint64_t index) const {
+        std::string digits = std::to_string(index);
+        if (digits.size() < static_cast<size_t>(png_digits)) digits.insert(0, png_digits - digits.size(), '0');
+        return png_prefix + digits + png_suffix;
+    }
+
+    void encoder_loop() {
+        while (true) {
+            size_t slot;
+            uint64_t index;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv_pending.wait(lock, [&] { return stopping || !pending.empty(); });
+                if (pending.empty()) return;
+                slot = pending.front();
+                pending.pop_front();
+                index = frames_done + frames_failed;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bool ok = true;
+            if (mode == WRITER_PNG) {
+                ok = cv::imwrite(png_path(index), buffers[slot]);
+            } else {
+                video.write(buffers[slot]);
+            }
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                encode_sec += sec;
+                if (ok) frames_done++;
+                else frames_failed++;
+                free_slots.push_back(slot);
+            }
+            cv_free.notify_one();
+        }
+    }
+
+public:
+    explicit FrameWriter(size_t queue = FRAME_WRITER_QUEUE) : queue_frames(queue < 1 ? 1 : queue) {}
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    ~FrameWriter() {
+        close();
+    }
+
+    /**
+     * Tach mau ten file PNG thanh prefix / so chu so / suffix. Mau hop le co dung 1 truong
+     * so nguyen kieu printf (%d, %u, %llu, %06llu ...; co the co '0' va do rong, khong flag
+     * nao khac) va khong co '%' nao khac. Mau khong co '%': so frame (6 chu so) duoc chen
+     * truoc phan mo rong, vd "out/frame.png" -> "out/frame_000000.png".
+     * Ten file duoc ghep bang std::string, mau khong bao gio di vao printf.
+     */
+    static bool parse_png_pattern(const std::string& pattern, std::string& prefix, int& digits,
+                                  std::string& suffix) {
+        const size_t pct = pattern.find('%');
+        if (pct == std::string::npos) {
+            const size_t slash = pattern.rfind('/');
+            size_t dot = pattern.rfind('.');
+            if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = pattern.size();
+            prefix = pattern.substr(0, dot) + "_";
+            digits = FRAME_WRITER_DIGITS;
+            suffix = pattern.substr(dot);
+            return true;
+        }
+
+        size_t k = pct + 1;
+        int width = 0;
+        while (k < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[k]))) {
+            width = width * 10 + (pattern[k] - '0');   // leading '0' (zero padding) adds nothing
+            if (width > 20) return false;                 // wider than any uint64_t
+            k++;
+        }
+        if (pattern.compare(k, 2, "ll") == 0) k += 2;
+        else if (k < pattern.size() && (pattern[k] == 'l' || pattern[k] == 'z' || pattern[k] == 'j')) k++;
+        if (k >= pattern.size() || (pattern[k] != 'd' && pattern[k] != 'i' && pattern[k] != 'u')) return false;
+        if (pattern.find('%', k + 1) != std::string::npos) return false;
+
+        prefix = pattern.substr(0, pct);
+        digits = width;
+        suffix = pattern.substr(k + 1);
+        return true;
+    }
+
+    /**
+     * Ghi moi frame ra 1 file PNG.
+     * @param pattern Mau ten file, vd "out/frame_%06llu.png" (xem parse_png_pattern()).
+     * Tra ve false neu mau sai hoac thu muc khong ghi duoc.
+     */
+    bool open_png(const std::string& pattern) {
+        if (mode != WRITER_CLOSED) close();
+        if (!parse_png_pattern(pattern, png_prefix, png_digits, png_suffix)) {
+            std::cerr << "Invalid PNG pattern: " << pattern
+                      << " (expected one integer field and no other '%', e.g. out/frame_%06llu.png)" << std::endl;
+            return false;
+        }
+        const size_t slash = png_prefix.rfind('/');
+        const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : png_prefix.substr(0, slash));
+        if (access(dir.c_str(), W_OK) != 0) {
+            std::cerr << "Cannot write PNG frames to directory: " << dir << std::endl;
+            return false;
+        }
+        return start(WRITER_PNG);
+    }
+
+    /**
+     * Ghi tat ca frame vao 1 file video (mp4v).
+     * @param fps Tan so frame cua video (Pandar64: 10 vong/s).
+     */
+    bool open_video(const std::string& path, double fps, cv::Size size) {
+        if (mode != WRITER_CLOSED) close();
+        if (!video.open(path, cv::VideoWriter::fourcc(FRAME_WRITER_FOURCC), fps, size, true)) {
+            std::cerr << "Failed to open video writer: " << path << std::endl;
+            return false;
+        }
+        return start(WRITER_VIDEO);
+    }
+
+    // Queue a copy of frame for encoding; blocks only while every buffer is busy
+    void write(const cv::Mat& frame) {
+        if (mode == WRITER_CLOSED) return;
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (free_slots.empty()) {
+                producer_waits++;
+                cv_free.wait(lock, [&] { return !free_slots.empty(); });
+            }
+            slot = free_slots.front();
+            free_slots.pop_front();
+        }
+        frame.copyTo(buffers[slot]);   // reuses the buffer once it has the frame size
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pending.push_back(slot);
+            frames_queued++;
+        }
+        cv_pending.notify_one();
+    }
+
+    // Encode everything still queued and close the output
+    void close() {
+        if (mode == WRITER_CLOSED) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv_pending.notify_one();
+        encoder.join();
+        if (mode == WRITER_VIDEO) video.release();
+        mode = WRITER_CLOSED;
+    }
+
+    inline bool is_open() const { return mode != WRITER_CLOSED; }
+    inline uint64_t queued() const { return frames_queued; }
+    // call after close()
+    inline uint64_t written() const { return frames_done; }
+    inline uint64_t failed() const { return frames_failed; }
+    inline uint64_t waits() const { return producer_waits; }
+    inline double encode_seconds() const { return encode_sec; }
+};
+
+#endif // FRAME_WRITER_H
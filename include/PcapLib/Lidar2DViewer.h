@@ -4,6 +4,19 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "PointCloudSoA.h"
+#include "PointSplat.h"
+#include "Viewport.h"
+#include "FrameWriter.h"
+#include "StageTimer.h"
+
+#define VIEWER_DEFAULT_FPS 30.0
+#define VIEWER_FRESH_BIT   4        // readyState: buffer moi chua duoc hien thi
+#define VIEWER_INDEX_MASK  3
+#define VIEWER_OVERLAY_REFRESH_NS 500000000LL   // latency overlay: text recomputed every 0.5 s
 
 class Lidar2DViewer {
 public:
@@ -11,8 +24,10 @@ public:
      * Constructor: Tạo cửa sổ GUI với kích thước mặc định.
      * @param width Chiều rộng cửa sổ (mặc định 800).
      * @param height Chiều cao cửa sổ (mặc định 600).
+     * @param headless Khong tao cua so (server khong co man hinh): publish() chi ve
+     *                 khi co FrameWriter, khong goi imshow/waitKey.
      */
-    Lidar2DViewer(int width = 800, int height = 600);
+    Lidar2DViewer(int width = 800, int height = 600, bool headless = false);
 
     /**
      * Destructor: Đóng cửa sổ tự động.
@@ -29,11 +44,83 @@ public:
                 const cv::Scalar& pointColor = cv::Scalar(0, 255, 0),
                 int pointSize = 2);
 
+    /**
+     * Ve truc tiep tu point cloud SoA: chi doc cot x, y.
+     * Diem (x, y) [m] -> pixel (W/2 - x*scale, H/2 - y*scale).
+     * @param cloud Point cloud dang cot.
+     * @param scale So pixel tren 1 met.
+     */
+    void update(const PointCloudSoA& cloud,
+                float scale,
+                const cv::Scalar& pointColor = cv::Scalar(0, 255, 0),
+                int pointSize = 2);
+
     /**
      * Hiển thị cửa sổ GUI.
      */
     void show();
 
+    /**
+     * Bat render thread: cua so duoc tao va cap nhat (imshow, waitKey) trong thread rieng
+     * voi tan so co dinh, doc tu canvas 3 buffer. Sau khi goi, dung publish() thay cho
+     * update()/show().
+     * @param fps So lan hien thi moi giay.
+     */
+    void start_render(double fps = VIEWER_DEFAULT_FPS);
+
+    /**
+     * Dung render thread va dong cua so.
+     */
+    void stop_render();
+
+    /**
+     * Gui 1 frame: ve cloud vao back buffer roi doi voi buffer cho hien thi, khong bao gio cho
+     * render thread. Neu render thread chua hien thi frame truoc, frame do bi bo (frame moi nhat thang).
+     * Khi chua start_render(): ve, show va waitKey(1) ngay tren thread goi.
+     */
+    void publish(const PointCloudSoA& cloud,
+                 float scale,
+                 const cv::Scalar& pointColor = cv::Scalar(0, 255, 0),
+                 int pointSize = 2);
+
+    /**
+     * Gui 1 frame tu raster cua duong ghep (Pandar64Parser::rasterize_packet): moi pixel co
+     * diem duoc to mau, cang nhieu diem cang sang. Raster phai cung kich thuoc cua so.
+     */
+    void publish(const RasterBuffer& raster,
+                 const cv::Scalar& pointColor = cv::Scalar(0, 255, 0));
+
+    /**
+     * Gan bo ghi file: moi frame publish() duoc ghi ra (PNG/video) tren thread encoder
+     * cua writer. nullptr = bo gan. Writer phai song lau hon viewer hoac duoc bo gan truoc.
+     */
+    inline void set_frame_writer(FrameWriter* writer) {
+        frameWriter = writer;
+    }
+
+    inline bool is_headless() const {
+        return headless;
+    }
+
+    /**
+     * Ve p50/p99/max cua tung stage (LatencyRegistry) o goc tren trai, chi tren man hinh:
+     * frame ghi ra file khong co overlay. Can bat do thoi gian (LatencyRegistry::set_enabled).
+     */
+    inline void set_latency_overlay(bool enable) {
+        latencyOverlay = enable;
+    }
+
+    /**
+     * Phim bam cuoi cung (ma cv::waitKey), -1 neu khong co. Doc xong thi xoa.
+     */
+    inline int poll_key() {
+        return lastKey.exchange(-1);
+    }
+
+    inline uint64_t published_frames() const { return publishedFrames.load(); }
+    inline uint64_t presented_frames() const { return presentedFrames.load(); }
+    inline uint64_t skipped_frames() const { return skippedFrames.load(); }
+
     /**
      * Đóng cửa sổ và giải phóng tài nguyên.
      */
@@ -50,6 +137,36 @@ private:
     int windowHeight;                   // Chiều cao cửa sổ.
     std::string windowName;             // Tên cửa sổ.
     bool isWindowCreated;               // Flag kiểm tra cửa sổ đã tạo chưa.
+    bool headless;                      // khong co cua so
+    FrameWriter* frameWriter {nullptr}; // ghi frame ra file (khong so huu)
+    std::vector<float> screenX;         // Toa do pixel tam (tai su dung giua cac lan ve).
+    std::vector<float> screenY;
+    PointSplatter splatter;             // ve diem truc tiep vao pixel (thay cv::circle)
+    bool latencyOverlay {false};
+    std::vector<std::string> overlayLines;   // chi thread goi publish()
+    int64_t overlayRefreshNs {0};
+
+    // render thread: processing ve vao buffers[backIndex], render thread hien thi
+    // buffers[frontIndex], readyState = index buffer vua ve xong | VIEWER_FRESH_BIT
+    cv::Mat buffers[3];
+    int backIndex {0};                  // chi thread goi publish()
+    int frontIndex {1};                 // chi render thread
+    std::atomic<int> readyState {2};
+    std::thread renderThread;
+    std::atomic<bool> rendering {false};
+    double renderFps {VIEWER_DEFAULT_FPS};
+    std::atomic<int> lastKey {-1};
+    std::atomic<uint64_t> publishedFrames {0};
+    std::atomic<uint64_t> presentedFrames {0};
+    std::atomic<uint64_t> skippedFrames {0};
+
+    void render_loop();
+    template <typename DrawFn>
+    void publish_with(DrawFn&& draw);
+    void draw_raster(cv::Mat& target, const RasterBuffer& raster, const cv::Scalar& pointColor);
+    void draw_latency_overlay(cv::Mat& target);
+    void draw_cloud(cv::Mat& target, const PointCloudSoA& cloud, float scale,
+                    const cv::Scalar& pointColor, int pointSize);
 };
 
 #endif // LIDAR2DViewer_H
\ No newline at end of file
@@ -0,0 +1,407 @@
+#pragma once
+//==============================================
+// Packet layouts of the supported sensor models
+// Every layout is a set of compile-time constants (channels, blocks, record
+// size, distance unit ...) plus a header check. The parser is instantiated
+// once per layout and the model of a stream is picked once, from its first
+// packet, so the per-packet loops run with constant bounds.
+//
+//   model        blocks  records / block   record  unit    header
+//   Pandar64        6    64                3 B     4 mm    8 B (0xEEFF, 64, 6)
+//   Pandar40P      10    40                3 B     4 mm    none, 0xFFEE per block
+//   PandarXT32      8    32                4 B     4 mm    12 B (0xEEFF, .., 32, 8)
+//   VLP-16         12    2 x 16 (2 firings) 3 B    2 mm    none, 0xFFEE per block
+//
+// In dual-return mode (tail byte 0x39; XT32 also 0x3B, 0x3C) consecutive
+// blocks are two echoes (last / strongest / first) of the same firing; the
+// parser tags every point with its echo and can drop the unwanted one before
+// decoding it.
+//
+// Pandar40P and VLP-16 have no packet header: a stream is only locked to
+// them by a payload of the exact size with every block flag in place
+// (identify()); truncated captures of these models need --model.
+//
+// Firing times: block_us between firing sequences (block pairs in dual
+// return), firing_us between the firings of one block, laser_us between the
+// channels of a firing. The packet is stamped (tail) at its first firing and
+// captured just after its last one.
+//==============================================
+#ifndef LIDAR_MODELS_H
+#define LIDAR_MODELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include "AngleCorrection.h"
+#include "PointCloudSoA.h"
+
+#define LIDAR_MAX_BLOCKS 12             // most blocks in one packet (VLP-16)
+#define LIDAR_MAX_PACKET_POINTS 400     // most points in one packet (Pandar40P)
+
+// Return-mode byte of the packet tail
+#define RETURN_MODE_FIRST           0x33    // XT32
+#define RETURN_MODE_STRONGEST       0x37
+#define RETURN_MODE_LAST            0x38
+#define RETURN_MODE_DUAL            0x39    // last + strongest: blocks in pairs sharing one azimuth
+#define RETURN_MODE_LAST_FIRST      0x3B    // XT32 dual: last + first
+#define RETURN_MODE_STRONGEST_FIRST 0x3C    // XT32 dual: first + strongest
+
+// Returns kept from dual-return packets (single-return packets are kept whole)
+enum ReturnSelection {
+    RETURNS_BOTH = 0,
+    RETURNS_STRONGEST,
+    RETURNS_LAST,
+    RETURNS_FIRST
+};
+
+// Packet tail (status fields) of the last decoded packet
+struct PacketTail {
+    bool valid {false};                 // tail present in the packet
+    double sensor_time {NAN};           // first firing, sensor clock (s, UTC); NAN if the sensor sends no date
+    double clock_offset {NAN};          // sensor_time - capture-clock time of the same firing
+    uint16_t motor_rpm {0};             // 0 if not reported (VLP-16)
+    uint8_t return_mode {RETURN_MODE_STRONGEST};
+    uint8_t high_temperature {0};       // Hesai: 1 = overheat, shutdown pending
+};
+
+// days since 1970-01-01 of a proleptic Gregorian date
+inline int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - static_cast<int>(era * 400);
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Hesai date/time bytes (year - 1900, month, day, hour, minute, second) + microseconds
+inline double hesai_utc(const uint8_t* b, uint32_t us) {
+    if (b[1] < 1 || b[1] > 12 || b[2] < 1 || b[2] > 31 || b[3] > 23 || b[4] > 59 || b[5] > 60 || us >= 1000000) {
+        return NAN;
+    }
+    const int64_t days = days_from_civil(1900 + b[0], b[1], b[2]);
+    return static_cast<double>(days * 86400 + b[3] * 3600 + b[4] * 60 + b[5]) + us * 1e-6;
+}
+
+inline uint32_t read_u32le(const uint8_t* b) {
+    return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+}
+
+// Pandar64 / Pandar40P tail: reserved 5, high temperature 1, reserved 2, motor speed 2,
+// timestamp (us) 4, return mode 1, factory 1, date/time 6
+inline bool read_hesai_tail(const uint8_t* p, size_t len, size_t offset, PacketTail& tail) {
+    if (len < offset + 22) return false;
+    const uint8_t* t = p + offset;
+    tail.valid = true;
+    tail.high_temperature = t[5];
+    tail.motor_rpm = static_cast<uint16_t>(t[8] | (t[9] << 8));
+    tail.return_mode = t[14];
+    tail.sensor_time = hesai_utc(t + 16, read_u32le(t + 10));
+    return true;
+}
+
+// 0xFFEE in front of each of `blocks` blocks of `block_bytes`
+inline bool block_flags_present(const uint8_t* p, int blocks, size_t block_bytes) {
+    for (int b = 0; b < blocks; b++, p += block_bytes) {
+        if (p[0] != 0xFF || p[1] != 0xEE) return false;
+    }
+    return true;
+}
+
+enum LidarModel {
+    MODEL_AUTO = 0,             // detected from the first packet of the stream
+    MODEL_PANDAR64,
+    MODEL_PANDAR40P,
+    MODEL_PANDARXT32,
+    MODEL_VLP16
+};
+
+struct Pandar64Layout {
+    static constexpr LidarModel model = MODEL_PANDAR64;
+    static constexpr int lasers = 64;           // records per firing
+    static constexpr int firings = 1;           // firing sequences per block
+    static constexpr int blocks = 6;
+    static constexpr int record_bytes = 3;      // distance (2), intensity (1)
+    static constexpr int header_bytes = 8;      // before the first block
+    static constexpr int flag_bytes = 0;        // 0xFFEE in front of each block
+    static constexpr float dist_unit = 0.004f;
+    static constexpr int return_mode_offset = 1186;    // tail: 5 + 1 + 2 + 2 + 4 bytes in
+    static constexpr int tail_offset = 1172;
+    static constexpr float block_us = 55.56f;           // 10 Hz, 0.2 deg
+    static constexpr float firing_us = 0.0f;
+    static constexpr float laser_us = 0.72f;            // nominal, channels spread evenly over the firing
+
+    static inline bool read_tail(const uint8_t* p, size_t len, double, PacketTail& tail) {
+        return read_hesai_tail(p, len, tail_offset, tail);
+    }
+
+    static inline bool check(const uint8_t* p, size_t len) {
+        return len >= header_bytes && p[0] == 0xEE && p[1] == 0xFF && p[2] == lasers && p[3] == blocks;
+    }
+};
+
+struct Pandar40PLayout {
+    static constexpr LidarModel model = MODEL_PANDAR40P;
+    static constexpr int lasers = 40;
+    static constexpr int firings = 1;
+    static constexpr int blocks = 10;
+    static constexpr int record_bytes = 3;
+    static constexpr int header_bytes = 0;
+    static constexpr int flag_bytes = 2;
+    static constexpr float dist_unit = 0.004f;
+    static constexpr int return_mode_offset = 1254;    // same tail layout as Pandar64
+    static constexpr int tail_offset = 1240;
+    static constexpr size_t payload_bytes = 1262;       // tail_offset + 22-byte tail
+    static constexpr float block_us = 55.56f;
+    static constexpr float firing_us = 0.0f;
+    static constexpr float laser_us = 1.2f;             // nominal
+
+    static inline bool read_tail(const uint8_t* p, size_t len, double, PacketTail& tail) {
+        return read_hesai_tail(p, len, tail_offset, tail);
+    }
+
+    static inline bool check(const uint8_t* p, size_t len) {
+        const size_t block = flag_bytes + 2 + lasers * record_bytes;
+        return len >= 2 * block && p[0] == 0xFF && p[1] == 0xEE && p[block] == 0xFF && p[block + 1] == 0xEE;
+    }
+
+    // Stream detection: check() alone also matches VLP-16 data bytes that happen to read FF EE
+    static inline bool identify(const uint8_t* p, size_t len) {
+        return len == payload_bytes && block_flags_present(p, blocks, flag_bytes + 2 + lasers * record_bytes);
+    }
+};
+
+struct PandarXT32Layout {
+    static constexpr LidarModel model = MODEL_PANDARXT32;
+    static constexpr int lasers = 32;
+    static constexpr int firings = 1;
+    static constexpr int blocks = 8;
+    static constexpr int record_bytes = 4;      // distance (2), intensity (1), confidence (1)
+    static constexpr int header_bytes = 12;
+    static constexpr int flag_bytes = 0;
+    static constexpr float dist_unit = 0.004f;
+    static constexpr int return_mode_offset = 1062;    // tail: 10 reserved bytes in
+    static constexpr int tail_offset = 1052;
+    static constexpr float block_us = 50.0f;
+    static constexpr float firing_us = 0.0f;
+    static constexpr float laser_us = 1.512f;
+
+    // tail: reserved 10, return mode 1, motor speed 2, date/time 6, timestamp (us) 4, factory 1
+    static inline bool read_tail(const uint8_t* p, size_t len, double, PacketTail& tail) {
+        if (len < tail_offset + 24) return false;
+        const uint8_t* t = p + tail_offset;
+        tail.valid = true;
+        tail.return_mode = t[10];
+        tail.motor_rpm = static_cast<uint16_t>(t[11] | (t[12] << 8));
+        tail.sensor_time = hesai_utc(t + 13, read_u32le(t + 19));
+        return true;
+    }
+
+    static inline bool check(const uint8_t* p, size_t len) {
+        return len >= header_bytes && p[0] == 0xEE && p[1] == 0xFF && p[6] == lasers && p[7] == blocks;
+    }
+};
+
+struct VLP16Layout {
+    static constexpr LidarModel model = MODEL_VLP16;
+    static constexpr int lasers = 16;
+    static constexpr int firings = 2;           // second firing half-way to the next block azimuth
+    static constexpr int blocks = 12;
+    static constexpr int record_bytes = 3;
+    static constexpr int header_bytes = 0;
+    static constexpr int flag_bytes = 2;
+    static constexpr float dist_unit = 0.002f;
+    static constexpr int return_mode_offset = 1204;    // after the 4-byte timestamp
+    static constexpr int tail_offset = 1200;
+    static constexpr size_t payload_bytes = 1206;       // tail_offset + 6-byte tail
+    static constexpr float block_us = 110.592f;
+    static constexpr float firing_us = 55.296f;
+    static constexpr float laser_us = 2.304f;
+
+    // tail: timestamp (us past the hour) 4, return mode 1, factory 1. The hour is
+    // taken from the capture clock (nearest one).
+    static inline bool read_tail(const uint8_t* p, size_t len, double capture_time, PacketTail& tail) {
+        if (len < tail_offset + 6) return false;
+        const uint8_t* t = p + tail_offset;
+        tail.valid = true;
+        tail.return_mode = t[4];
+        const uint32_t us = read_u32le(t);
+        if (us >= 3600000000u) return true;
+        double hour = std::floor(capture_time / 3600.0) * 3600.0;
+        double stamp = hour + us * 1e-6;
+        if (stamp - capture_time > 1800.0) stamp -= 3600.0;
+        else if (capture_time - stamp > 1800.0) stamp += 3600.0;
+        tail.sensor_time = stamp;
+        return true;
+    }
+
+    static inline bool check(const uint8_t* p, size_t len) {
+        const size_t block = flag_bytes + 2 + firings * lasers * record_bytes;
+        return len >= 2 * block && p[0] == 0xFF && p[1] == 0xEE && p[block] == 0xFF && p[block + 1] == 0xEE;
+    }
+
+    static inline bool identify(const uint8_t* p, size_t len) {
+        return len == payload_bytes && block_flags_present(p, blocks, flag_bytes + 2 + firings * lasers * record_bytes);
+    }
+};
+
+// bytes of one block, azimuth and flag included
+template <typename Layout>
+constexpr int layout_block_bytes() {
+    return Layout::flag_bytes + 2 + Layout::firings * Layout::lasers * Layout::record_bytes;
+}
+
+// time (us) from the first to the last firing of a full packet; pair = 2 in dual return
+template <typename Layout>
+inline float layout_span_us(int pair) {
+    return (Layout::blocks / pair - 1) * Layout::block_us + (Layout::firings - 1) * Layout::firing_us +
+           (Layout::lasers - 1) * Layout::laser_us;
+}
+
+// points one packet can produce
+template <typename Layout>
+constexpr int layout_points() {
+    return Layout::blocks * Layout::firings * Layout::lasers;
+}
+
+static_assert(layout_points<Pandar64Layout>() <= LIDAR_MAX_PACKET_POINTS &&
+              layout_points<Pandar40PLayout>() <= LIDAR_MAX_PACKET_POINTS &&
+              layout_points<PandarXT32Layout>() <= LIDAR_MAX_PACKET_POINTS &&
+              layout_points<VLP16Layout>() <= LIDAR_MAX_PACKET_POINTS, "LIDAR_MAX_PACKET_POINTS too small");
+static_assert(Pandar40PLayout::tail_offset == Pandar40PLayout::blocks * layout_block_bytes<Pandar40PLayout>() &&
+              VLP16Layout::tail_offset == VLP16Layout::blocks * layout_block_bytes<VLP16Layout>(),
+              "tail must follow the last block");
+static_assert(Pandar40PLayout::blocks <= LIDAR_MAX_BLOCKS && VLP16Layout::blocks <= LIDAR_MAX_BLOCKS,
+              "LIDAR_MAX_BLOCKS too small");
+
+// Return mode of a packet; truncated packets count as single (strongest) return
+template <typename Layout>
+inline uint8_t layout_return_mode(const uint8_t* payload, size_t len) {
+    return len > static_cast<size_t>(Layout::return_mode_offset) ? payload[Layout::return_mode_offset]
+                                                                  : RETURN_MODE_STRONGEST;
+}
+
+// Blocks come in pairs (one per echo) sharing one azimuth
+inline bool return_mode_is_dual(uint8_t return_mode) {
+    return return_mode == RETURN_MODE_DUAL || return_mode == RETURN_MODE_LAST_FIRST ||
+           return_mode == RETURN_MODE_STRONGEST_FIRST;
+}
+
+// Which echo block `blk` holds. Dual (0x39): even blocks last return, odd blocks strongest
+// (second strongest when both are the same echo); 0x3B: last / first; 0x3C: first / strongest.
+inline uint8_t block_return(uint8_t return_mode, int blk) {
+    switch (return_mode) {
+        case RETURN_MODE_DUAL:            return (blk & 1) ? POINT_RETURN_STRONGEST : POINT_RETURN_LAST;
+        case RETURN_MODE_LAST_FIRST:      return (blk & 1) ? POINT_RETURN_FIRST : POINT_RETURN_LAST;
+        case RETURN_MODE_STRONGEST_FIRST: return (blk & 1) ? POINT_RETURN_STRONGEST : POINT_RETURN_FIRST;
+        case RETURN_MODE_LAST:            return POINT_RETURN_LAST;
+        case RETURN_MODE_FIRST:           return POINT_RETURN_FIRST;
+        default:                          return POINT_RETURN_STRONGEST;
+    }
+}
+
+inline bool return_selected(ReturnSelection selection, uint8_t ret) {
+    switch (selection) {
+        case RETURNS_STRONGEST: return ret == POINT_RETURN_STRONGEST;
+        case RETURNS_LAST:      return ret == POINT_RETURN_LAST;
+        case RETURNS_FIRST:     return ret == POINT_RETURN_FIRST;
+        default:                return true;
+    }
+}
+
+// "both" | "strongest" | "last" | "first"; false if unknown
+inline bool parse_return_selection(const std::string& name, ReturnSelection& selection) {
+    if (name == "both") selection = RETURNS_BOTH;
+    else if (name == "strongest") selection = RETURNS_STRONGEST;
+    else if (name == "last") selection = RETURNS_LAST;
+    else if (name == "first") selection = RETURNS_FIRST;
+    else return false;
+    return true;
+}
+
+// Model of a UDP payload, MODEL_AUTO if none matches (models without header: full packets only)
+inline LidarModel detect_model(const uint8_t* payload, size_t len) {
+    if (!payload) return MODEL_AUTO;
+    if (Pandar64Layout::check(payload, len)) return MODEL_PANDAR64;
+    if (PandarXT32Layout::check(payload, len)) return MODEL_PANDARXT32;
+    if (Pandar40PLayout::identify(payload, len)) return MODEL_PANDAR40P;
+    if (VLP16Layout::identify(payload, len)) return MODEL_VLP16;
+    return MODEL_AUTO;
+}
+
+inline const char* model_name(LidarModel model) {
+    switch (model) {
+        case MODEL_PANDAR64:   return "pandar64";
+        case MODEL_PANDAR40P:  return "pandar40p";
+        case MODEL_PANDARXT32: return "xt32";
+        case MODEL_VLP16:      return "vlp16";
+        default:               return "auto";
+    }
+}
+
+inline int model_lasers(LidarModel model) {
+    switch (model) {
+        case MODEL_PANDAR40P:  return Pandar40PLayout::lasers;
+        case MODEL_PANDARXT32: return PandarXT32Layout::lasers;
+        case MODEL_VLP16:      return VLP16Layout::lasers;
+        default:               return Pandar64Layout::lasers;
+    }
+}
+
+// "pandar64" | "pandar40p" | "xt32" | "vlp16" | "auto"; false if unknown
+inline bool parse_model_name(const std::string& name, LidarModel& model) {
+    for (LidarModel m : { MODEL_AUTO, MODEL_PANDAR64, MODEL_PANDAR40P, MODEL_PANDARXT32, MODEL_VLP16 }) {
+        if (name == model_name(m)) {
+            model = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Bang goc danh nghia cua tung model (datasheet). Pandar40P / XT32: lech azimuth = 0,
+ * nen dung file calibration cua tung sensor neu can do chinh xac.
+ */
+inline const AngleCorrection& default_angles(LidarModel model) {
+    static const AngleCorrection pandar40p = [] {
+        AngleCorrection c {};
+        const float elev[40] = {
+            15.0f, 11.0f, 8.0f, 5.0f, 3.0f, 2.0f, 1.67f, 1.33f, 1.0f, 0.67f,
+            0.33f, 0.0f, -0.33f, -0.67f, -1.0f, -1.33f, -1.67f, -2.0f, -2.33f, -2.67f,
+            -3.0f, -3.33f, -3.67f, -4.0f, -4.33f, -4.67f, -5.0f, -5.33f, -5.67f, -6.0f,
+            -7.0f, -8.0f, -9.0f, -10.0f, -11.0f, -12.0f, -13.0f, -14.0f, -19.0f, -25.0f
+        };
+        c.lasers = 40;
+        std::memcpy(c.elevation, elev, sizeof(elev));
+        c.source = "built-in pandar40p";
+        c.derive();
+        return c;
+    }();
+    static const AngleCorrection xt32 = [] {
+        AngleCorrection c {};
+        c.lasers = 32;
+        for (int l = 0; l < 32; l++) c.elevation[l] = 15.0f - l;   // 15 .. -16 deg, 1 deg apart
+        c.source = "built-in xt32";
+        c.derive();
+        return c;
+    }();
+    static const AngleCorrection vlp16 = [] {
+        AngleCorrection c {};
+        c.lasers = 16;
+        for (int l = 0; l < 16; l++) c.elevation[l] = (l % 2) ? static_cast<float>(l) : static_cast<float>(l - 15);
+        c.source = "built-in vlp16";
+        c.derive();
+        return c;
+    }();
+    switch (model) {
+        case MODEL_PANDAR40P:  return pandar40p;
+        case MODEL_PANDARXT32: return xt32;
+        case MODEL_VLP16:      return vlp16;
+        default:               return AngleCorrection::pandar64_default();
+    }
+}
+
+#endif // LIDAR_MODELS_H
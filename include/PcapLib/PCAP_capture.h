@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
+#include "StageTimer.h"
 
 #define SNAP_LEN     65535
 #define PROMISC      1
@@ -31,6 +32,17 @@ struct PCAP_Packet {
     std::vector<u_char> packet_data;   // copy an toàn dữ liệu
 };
 
+// Non-owning view of one packet (header + pointer into a buffer owned elsewhere,
+// e.g. a memory-mapped file). Valid only as long as the owner is alive.
+struct PCAP_PacketView {
+    PCAP_Header packet_header;
+    const u_char* packet_data;
+};
+
+inline PCAP_PacketView make_packet_view(const PCAP_Packet& packet) {
+    return { packet.packet_header, packet.packet_data.data() };
+}
+
 //================ CLASS ========================
 class PCAP_capture {
 private:
@@ -80,8 +92,10 @@ public:
         struct pcap_pkthdr* header;
         const u_char* data;
 
+        StageTimer timer(STAGE_CAPTURE);
         int response = pcap_next_ex(handle, &header, &data);
         if (response <= 0) {
+            timer.cancel();   // timeout / end of file: nothing captured
             if (response == -1)
                 std::cerr << "Error when reading packet: " << pcap_geterr(handle) << std::endl;
             return false;
@@ -98,6 +112,33 @@ public:
         return true;
     }
 
+    // Read one packet without copying: view points into libpcap's buffer and
+    // stays valid only until the next read on this handle.
+    bool read_packet(PCAP_PacketView& packet) {
+        if (!isOpen || !handle) return false;
+
+        struct pcap_pkthdr* header;
+        const u_char* data;
+
+        StageTimer timer(STAGE_CAPTURE);
+        int response = pcap_next_ex(handle, &header, &data);
+        if (response <= 0) {
+            timer.cancel();   // timeout / end of file: nothing captured
+            if (response == -1)
+                std::cerr << "Error when reading packet: " << pcap_geterr(handle) << std::endl;
+            return false;
+        }
+
+        packet.packet_header = {
+            static_cast<uint32_t>(header->ts.tv_sec),
+            static_cast<uint32_t>(header->ts.tv_usec),
+            header->caplen,
+            header->len
+        };
+        packet.packet_data = data;
+        return true;
+    }
+
     // Set non-blocking mode
     bool set_non_blocking(bool enable) {
         if (!isOpen || !handle) return false;
@@ -178,7 +219,26 @@ public:
         return isOpen;
     }
 
+    // Link-layer type of the open handle (DLT_EN10MB when closed)
+    inline int datalink() const {
+        return (isOpen && handle) ? pcap_datalink(handle) : DLT_EN10MB;
+    }
+
+    // Read up to max_packets packets into window, reusing the buffers already
+    // held by its elements. Returns the number of packets read (0 at EOF/error).
+    // Memory stays bounded by max_packets * SNAP_LEN, independent of file size.
+    size_t read_packets(std::vector<PCAP_Packet>& window, size_t max_packets) {
+        if (window.size() < max_packets) window.resize(max_packets);
+
+        size_t count = 0;
+        while (count < max_packets && read_packet(window[count])) {
+            count++;
+        }
+        return count;
+    }
+
     // Read all packets from file/device
+    // NOTE: copies the whole capture into memory, prefer read_packets() for replay
     std::vector<PCAP_Packet> read_all_packets() {
         std::vector<PCAP_Packet> all_packets;
         PCAP_Packet pkt;
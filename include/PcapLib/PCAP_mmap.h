@@ -0,0 +1,329 @@
+#pragma once
+//==============================================
+// Memory-mapped pcap / pcapng reader
+// Hands out PCAP_PacketView pointing straight into the mapped file:
+// no per-packet allocation, no memcpy.
+//==============================================
+#ifndef PCAP_MMAP_H
+#define PCAP_MMAP_H
+
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "PCAP_capture.h"
+
+#define PCAP_MAGIC_USEC      0xA1B2C3D4u
+#define PCAP_MAGIC_NSEC      0xA1B23C4Du
+#define PCAPNG_SHB_TYPE      0x0A0D0D0Au
+#define PCAPNG_BYTE_ORDER    0x1A2B3C4Du
+#define PCAPNG_IDB_TYPE      0x00000001u
+#define PCAPNG_SPB_TYPE      0x00000003u
+#define PCAPNG_EPB_TYPE      0x00000006u
+#define PCAPNG_MAX_IFACES    16
+
+class PCAP_mmap {
+private:
+    struct Interface {
+        uint32_t link_type;
+        uint32_t snap_len;
+        uint64_t ticks_per_second;   // if_tsresol, default microsecond
+    };
+
+    int fd {-1};
+    const u_char* base {nullptr};
+    size_t file_size {0};
+    size_t cursor {0};               // offset of the next record/block
+    size_t first_record {0};         // offset right after the file header
+    size_t released {0};             // pages before this offset were dropped, never past the cursor
+    bool isOpen {false};
+    bool is_ng {false};
+    bool swapped {false};            // file endianness differs from host
+    bool nanosecond {false};         // classic pcap with ns timestamps
+    uint32_t link_type {0};
+    Interface ifaces[PCAPNG_MAX_IFACES] {};
+    size_t iface_count {0};
+
+    // after moving the cursor back: release_consumed() drops the pages read again, starting at the cursor
+    inline void clamp_released() {
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        released = std::min(released, (cursor / page) * page);
+    }
+
+    inline uint16_t rd16(size_t off) const {
+        uint16_t v;
+        std::memcpy(&v, base + off, sizeof(v));
+        return swapped ? static_cast<uint16_t>((v >> 8) | (v << 8)) : v;
+    }
+
+    inline uint32_t rd32(size_t off) const {
+        uint32_t v;
+        std::memcpy(&v, base + off, sizeof(v));
+        return swapped ? __builtin_bswap32(v) : v;
+    }
+
+    bool parse_file_header() {
+        if (file_size < 24) {
+            std::cerr << "Error when opening file: too short for a pcap header" << std::endl;
+            return false;
+        }
+
+        uint32_t magic;
+        std::memcpy(&magic, base, sizeof(magic));
+
+        if (magic == PCAPNG_SHB_TYPE) {
+            uint32_t bom;
+            std::memcpy(&bom, base + 8, sizeof(bom));
+            if (bom != PCAPNG_BYTE_ORDER && __builtin_bswap32(bom) != PCAPNG_BYTE_ORDER) {
+                std::cerr << "Error when opening file: bad pcapng byte-order magic" << std::endl;
+                return false;
+            }
+            is_ng = true;
+            swapped = (bom != PCAPNG_BYTE_ORDER);
+            first_record = 0;   // SHB is handled as a regular block
+            return true;
+        }
+
+        swapped = (magic == __builtin_bswap32(PCAP_MAGIC_USEC) ||
+                   magic == __builtin_bswap32(PCAP_MAGIC_NSEC));
+        uint32_t m = swapped ? __builtin_bswap32(magic) : magic;
+        if (m != PCAP_MAGIC_USEC && m != PCAP_MAGIC_NSEC) {
+            std::cerr << "Error when opening file: unknown pcap magic" << std::endl;
+            return false;
+        }
+        nanosecond = (m == PCAP_MAGIC_NSEC);
+        link_type = rd32(20) & 0x0FFFFFFF;
+        first_record = 24;
+        return true;
+    }
+
+    // if_tsresol option of an Interface Description Block
+    uint64_t read_tsresol(size_t opt, size_t opt_end) const {
+        while (opt + 4 <= opt_end) {
+            uint16_t code = rd16(opt);
+            uint16_t len = rd16(opt + 2);
+            if (code == 0) break;
+            if (code == 9 && len >= 1 && opt + 5 <= opt_end) {
+                uint8_t res = base[opt + 4];
+                uint8_t exp = res & 0x7F;
+                if (exp > ((res & 0x80) ? 63 : 19)) return 1000000;
+                uint64_t ticks = 1;
+                for (uint8_t e = 0; e < exp; e++) ticks *= (res & 0x80) ? 2 : 10;
+                return ticks;
+            }
+            opt += 4 + ((len + 3u) & ~3u);
+        }
+        return 1000000;
+    }
+
+    bool next_classic(PCAP_PacketView& view) {
+        if (cursor + 16 > file_size) return false;
+
+        uint32_t ts_sec = rd32(cursor);
+        uint32_t ts_frac = rd32(cursor + 4);
+        uint32_t caplen = rd32(cursor + 8);
+        uint32_t len = rd32(cursor + 12);
+        if (caplen > SNAP_LEN * 4u || cursor + 16 + caplen > file_size) {
+            std::cerr << "Error when reading packet: truncated record at offset " << cursor << std::endl;
+            return false;
+        }
+
+        view.packet_header = { ts_sec, nanosecond ? ts_frac / 1000 : ts_frac, caplen, len };
+        view.packet_data = base + cursor + 16;
+        cursor += 16 + caplen;
+        return true;
+    }
+
+    bool next_ng(PCAP_PacketView& view) {
+        while (cursor + 12 <= file_size) {
+            uint32_t type;
+            std::memcpy(&type, base + cursor, sizeof(type));
+
+            if (type == PCAPNG_SHB_TYPE) {
+                // a new section may change the byte order
+                uint32_t bom;
+                std::memcpy(&bom, base + cursor + 8, sizeof(bom));
+                swapped = (bom != PCAPNG_BYTE_ORDER);
+                iface_count = 0;
+            } else if (swapped) {
+                type = __builtin_bswap32(type);
+            }
+
+            uint32_t block_len = rd32(cursor + 4);
+            if (block_len < 12 || (block_len & 3) || cursor + block_len > file_size) {
+                std::cerr << "Error when reading packet: bad pcapng block at offset " << cursor << std::endl;
+                return false;
+            }
+
+            size_t block = cursor;
+            cursor += block_len;
+
+            if (type == PCAPNG_IDB_TYPE && block_len >= 20) {
+                if (iface_count < PCAPNG_MAX_IFACES) {
+                    Interface& itf = ifaces[iface_count++];
+                    itf.link_type = rd16(block + 8);
+                    itf.snap_len = rd32(block + 12);
+                    itf.ticks_per_second = read_tsresol(block + 16, block + block_len - 4);
+                    if (iface_count == 1) link_type = itf.link_type;
+                }
+            } else if (type == PCAPNG_EPB_TYPE && block_len >= 32) {
+                uint32_t iface = rd32(block + 8);
+                uint64_t ts = (static_cast<uint64_t>(rd32(block + 12)) << 32) | rd32(block + 16);
+                uint32_t caplen = rd32(block + 20);
+                uint32_t len = rd32(block + 24);
+                if (28 + static_cast<size_t>(caplen) > block_len - 4) continue;
+
+                uint64_t tps = (iface < iface_count) ? ifaces[iface].ticks_per_second : 1000000;
+                view.packet_header = {
+                    static_cast<uint32_t>(ts / tps),
+                    static_cast<uint32_t>((ts % tps) * 1000000 / tps),
+                    caplen, len
+                };
+                view.packet_data = base + block + 28;
+                return true;
+            } else if (type == PCAPNG_SPB_TYPE && block_len >= 16) {
+                uint32_t len = rd32(block + 8);
+                uint32_t caplen = static_cast<uint32_t>(block_len - 16);
+                if (iface_count > 0 && ifaces[0].snap_len > 0 && caplen > ifaces[0].snap_len)
+                    caplen = ifaces[0].snap_len;
+                if (caplen > len) caplen = len;
+                view.packet_header = { 0, 0, caplen, len };   // SPB carries no timestamp
+                view.packet_data = base + block + 12;
+                return true;
+            }
+            // other blocks (statistics, name resolution, ...) are skipped
+        }
+        return false;
+    }
+
+public:
+    PCAP_mmap() = default;
+    PCAP_mmap(const PCAP_mmap&) = delete;
+    PCAP_mmap& operator=(const PCAP_mmap&) = delete;
+
+    ~PCAP_mmap() {
+        close_file();
+    }
+
+    //==========================================================================
+    // Map a .pcap or .pcapng file read-only
+    //==========================================================================
+    bool open_file(const std::string& pcap_file_dir) {
+        close_file();
+
+        fd = ::open(pcap_file_dir.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error when opening file:- " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            std::cerr << "Error when opening file:- empty or unreadable file" << std::endl;
+            close_file();
+            return false;
+        }
+        file_size = static_cast<size_t>(st.st_size);
+
+        void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "Error when mapping file:- " << std::strerror(errno) << std::endl;
+            close_file();
+            return false;
+        }
+        base = static_cast<const u_char*>(addr);
+        madvise(addr, file_size, MADV_SEQUENTIAL);
+
+        if (!parse_file_header()) {
+            close_file();
+            return false;
+        }
+        cursor = first_record;
+        released = 0;
+        isOpen = true;
+        return true;
+    }
+
+    // Next packet as a view into the mapped file. Returns false at EOF/error.
+    inline bool read_packet(PCAP_PacketView& view) {
+        if (!isOpen) return false;
+        StageTimer timer(STAGE_CAPTURE);
+        if (is_ng ? next_ng(view) : next_classic(view)) return true;
+        timer.cancel();   // end of file / bad record: nothing read
+        return false;
+    }
+
+    // Drop already-consumed pages from the resident set, so RSS stays bounded
+    // while streaming through large captures. Views before the cursor stay
+    // valid (pages are re-read from the file if touched again).
+    void release_consumed() {
+        if (!isOpen) return;
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t end = (cursor / page) * page;
+        if (end > released) {
+            madvise(const_cast<u_char*>(base) + released, end - released, MADV_DONTNEED);
+            released = end;
+        }
+    }
+
+    void rewind() {
+        cursor = first_record;
+        iface_count = 0;
+        clamp_released();
+    }
+
+    // Continue reading at a record/block offset taken earlier from offset()
+    // (e.g. from an index sidecar). For pcapng the section header and
+    // interfaces in front of the first packet are loaded first; interfaces
+    // declared later in the file are not known after a seek.
+    bool seek(size_t off) {
+        if (!isOpen || off < first_record || off >= file_size) return false;
+        if (is_ng) {
+            const size_t kept = released;   // the header pages read here do not move the watermark
+            rewind();
+            PCAP_PacketView first;
+            next_ng(first);
+            released = kept;
+        }
+        cursor = off;
+        clamp_released();
+        return true;
+    }
+
+    void close_file() {
+        if (base) {
+            munmap(const_cast<u_char*>(base), file_size);
+            base = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        file_size = 0;
+        cursor = 0;
+        released = 0;
+        isOpen = false;
+
+        // header-derived state: the next open_file() may be the other format
+        first_record = 0;
+        is_ng = false;
+        swapped = false;
+        nanosecond = false;
+        link_type = 0;
+        iface_count = 0;
+    }
+
+    inline bool is_open() const { return isOpen; }
+    inline bool is_pcapng() const { return is_ng; }
+    inline uint32_t datalink() const { return link_type; }
+    inline size_t offset() const { return cursor; }
+    inline size_t size() const { return file_size; }
+};
+
+#endif // PCAP_MMAP_H
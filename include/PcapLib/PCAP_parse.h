@@ -10,130 +10,304 @@
 #include <cstring>
 #include <iostream>
 #include "PCAP_capture.h"
+#include "Pandar64_simd.h"
+#include "PointCloudSoA.h"
+#include "Viewport.h"
+#include "AngleCorrection.h"
+#include "LidarModels.h"
+#include "ParseStats.h"
+#include "StageTimer.h"
+
+#define AZIMUTH_STEPS 36000     // 0.01 deg azimuth resolution of the sensor
+#define MIN_RANGE_M   0.3f      // points closer than this are dropped
+
+// cos/sin of every raw azimuth value (0.01 deg steps), built once and shared by all parsers
+struct AzimuthLUT {
+    float cos_az[AZIMUTH_STEPS];
+    float sin_az[AZIMUTH_STEPS];
+
+    AzimuthLUT() {
+        for (int k = 0; k < AZIMUTH_STEPS; k++) {
+            double rad = k * 0.01 * M_PI / 180.0;
+            cos_az[k] = static_cast<float>(std::cos(rad));
+            sin_az[k] = static_cast<float>(std::sin(rad));
+        }
+    }
+
+    static const AzimuthLUT& instance() {
+        static const AzimuthLUT lut;
+        return lut;
+    }
+};
 
-struct PointXYZI {
-    float x;
-    float y;
-    float z;
-    uint8_t intensity;
+// Per-stream decode settings, applied with Pandar64Parser::configure()
+struct ParserOptions {
+    LidarModel model {MODEL_AUTO};
+    ReturnSelection returns {RETURNS_BOTH};
 };
 
+// Per-stream parser. Despite the name it decodes every model of LidarModels.h:
+// the model is fixed once (set_model() or the first recognised packet) and the
+// packet loop is the matching append_layout<> instantiation.
 class Pandar64Parser {
 public:
-    Pandar64Parser() {
-        init_vertical_angles();
-        init_azimuth_table();
+    Pandar64Parser() : az_lut(&AzimuthLUT::instance()), stats(std::make_shared<ParseStats>()) {
+        set_angle_correction(AngleCorrection::pandar64_default());
+        set_simd_level(detect_simd_level());
     }
 
-    // --- trong parse_packet ---
-inline std::vector<PointXYZI> parse_packet(const PCAP_Packet &packet) {
-    std::vector<PointXYZI> cloud;
+    // Force a block decoder (e.g. SIMD_SCALAR to compare against the SIMD path)
+    void set_simd_level(SimdLevel level) {
+        simd_level = level;
+        select_decoder();
+    }
 
-    if (packet.packet_data.empty()) return cloud;
+    /**
+     * Chon model cho ca stream (MODEL_AUTO: nhan dien tu packet dau tien hop le).
+     * Moi model la 1 ban template rieng cua vong giai ma, chon 1 lan o day.
+     */
+    void set_model(LidarModel m) {
+        model = m;
+        switch (m) {
+            case MODEL_PANDAR64:   use_layout<Pandar64Layout>(); break;
+            case MODEL_PANDAR40P:  use_layout<Pandar40PLayout>(); break;
+            case MODEL_PANDARXT32: use_layout<PandarXT32Layout>(); break;
+            case MODEL_VLP16:      use_layout<VLP16Layout>(); break;
+            default:
+                append_layout_fn = nullptr;
+                azimuths_layout_fn = nullptr;
+                break;
+        }
+        select_decoder();
+        set_angle_correction(default_angles(m));
+        calibration_generation = ~0ull;   // re-apply the calibration if it fits the model
+        require_calibration_lasers();
+        refresh_calibration();
+    }
 
-    const uint8_t* payload = nullptr;
-    size_t payload_len = 0;
-    if (!extract_udp_payload(packet.packet_data.data(),
-                             packet.packet_header.capture_length,
-                             payload, payload_len)) {
-        return cloud;
+    inline LidarModel get_model() const {
+        return model;
     }
 
-    if (payload_len < 4) return cloud;
+    /**
+     * Echo giu lai tu packet dual-return; echo bi loai khong duoc giai ma.
+     * Packet single-return luon giu nguyen.
+     */
+    inline void set_return_selection(ReturnSelection selection) {
+        return_selection = selection;
+    }
 
-    // check SOP
-    uint16_t sop = payload[0] | (payload[1] << 8);
+    // Return-mode byte of the last decoded packet (RETURN_MODE_*)
+    inline uint8_t get_return_mode() const {
+        return return_mode;
+    }
 
-    if (sop == 0xFFEE) {
-        // --- Format có header ---
-        uint8_t laser_num = payload[2];
-        uint8_t block_num = payload[3];
-        float dist_unit = 0.004f;
+    // Tail of the last packet decoded by parse_packet() (valid = false if it had none)
+    inline const PacketTail& last_tail() const {
+        return tail;
+    }
 
-        if (laser_num != 0x40 || block_num != 0x06) {
-            std::cerr << "[WARN] Invalid header: laser_num="
-                      << (int)laser_num << ", block_num=" << (int)block_num << std::endl;
-            return cloud;
-        }
+    void configure(const ParserOptions& options) {
+        if (options.model != MODEL_AUTO) set_model(options.model);
+        set_return_selection(options.returns);
+    }
 
-        const uint8_t* ptr = payload + 8;
-        for (int blk = 0; blk < 6; ++blk) {
-            if (ptr + 2 > payload + payload_len) break;
+    inline SimdLevel get_simd_level() const {
+        return simd_level;
+    }
 
-            uint16_t az_raw = ptr[0] | (ptr[1] << 8);
-            float azimuth_deg = az_raw * 0.01f;
-            if (azimuth_deg >= 360.0f) azimuth_deg -= 360.0f;
-            ptr += 2;
+    /**
+     * Counter dich cua parser (mac dinh: 1 bo rieng). Nhieu parser cua cung 1 sensor
+     * (ParsePool) dung chung 1 bo; nullptr = khong dem.
+     * Counter duoc cong vao sau moi packet, doc duoc tu thread khac bat ky luc nao.
+     */
+    inline void set_stats(std::shared_ptr<ParseStats> sink) {
+        stats = std::move(sink);
+    }
 
-            for (int ch = 0; ch < 64; ++ch) {
-                if (ptr + 3 > payload + payload_len) break;
+    inline const std::shared_ptr<ParseStats>& get_stats() const {
+        return stats;
+    }
 
-                uint16_t raw_dist = ptr[0] | (ptr[1] << 8);
-                uint8_t intensity = ptr[2];
-                ptr += 3;
+    // Fixed per-unit calibration (precomputed tables are copied, no trig here)
+    void set_angle_correction(const AngleCorrection& correction) {
+        std::memcpy(xy_cos, correction.xy_cos, sizeof(xy_cos));
+        std::memcpy(xy_sin, correction.xy_sin, sizeof(xy_sin));
+        std::memcpy(sin_elev, correction.sin_elev, sizeof(sin_elev));
+    }
 
-                if (raw_dist == 0) continue;
-                float distance_m = raw_dist * dist_unit;
-                if (distance_m < 0.3f) continue;
+    /**
+     * Calibration co the doi khi dang chay: parser kiem tra generation cua store truoc
+     * moi packet va chep bang moi (chi tren thread cua parser, khong khoa).
+     */
+    void set_calibration(std::shared_ptr<CalibrationStore> store) {
+        calibration = std::move(store);
+        calibration_generation = ~0ull;
+        require_calibration_lasers();
+        refresh_calibration();
+    }
+
+    inline PointCloudSoA parse_packet(const PCAP_Packet &packet) {
+        PointCloudSoA cloud;
+        if (!packet.packet_data.empty()) append_packet(make_packet_view(packet), cloud);
+        return cloud;
+    }
+
+    // Parse directly from a non-owning view (e.g. into a memory-mapped file), no copy.
+    inline PointCloudSoA parse_packet(const PCAP_PacketView &packet) {
+        PointCloudSoA cloud;
+        append_packet(packet, cloud);
+        return cloud;
+    }
 
-                int laser_id = ch;
-                if (laser_id >= 64) continue;
+    // Allocation-free variant: append into a caller-owned (pre-reserved) cloud.
+    // Returns the number of points added. No heap allocation once cloud has
+    // room for a packet (LIDAR_MAX_PACKET_POINTS).
+    inline size_t parse_packet(const PCAP_PacketView &packet, PointCloudSoA &cloud) {
+        return append_packet(packet, cloud);
+    }
 
-                float vert_rad = elevation_table[laser_id] * M_PI / 180.0f;
-                float az_offset = azimuth_table[laser_id];
-                float full_az_rad = (azimuth_deg + az_offset) * M_PI / 180.0f;
+    inline size_t parse_packet(const PCAP_Packet &packet, PointCloudSoA &cloud) {
+        if (packet.packet_data.empty()) return 0;
+        return append_packet(make_packet_view(packet), cloud);
+    }
 
-                PointXYZI p;
-                p.x = distance_m * cosf(vert_rad) * cosf(full_az_rad);
-                p.y = distance_m * cosf(vert_rad) * sinf(full_az_rad);
-                p.z = distance_m * sinf(vert_rad);
-                p.intensity = intensity;
-                cloud.push_back(p);
+    /**
+     * Duong ghep cho hien thi: giai ma thang ra toa do pixel, khong tao point cloud.
+     * Xoay/scale cua viewport duoc gop vao cos/sin azimuth cua moi block, nen pixel
+     * ra cung luc voi giai ma (cung decoder SIMD).
+     * fn(const float* sx, const float* sy, size_t n, uint16_t azimuth) duoc goi 1 lan moi
+     * block; sx, sy chi hop le trong luc goi. Tra ve so diem.
+     */
+    template <typename PixelFn>
+    size_t project_packet(const PCAP_PacketView &packet, const ViewportTransform &view, PixelFn &&fn) {
+        StageTimer timer(STAGE_PARSE);
+        const uint8_t* payload = nullptr;
+        size_t payload_len = 0;
+        if (!extract_udp_payload(packet.packet_data, packet.packet_header.capture_length,
+                                 payload, payload_len, &pending)) {
+            return finish_packet(0);
+        }
+        if (payload_len < 4) {
+            pending[PARSE_INVALID_SOP]++;
+            return finish_packet(0);
+        }
+        if (model == MODEL_AUTO) detect_stream_model(payload, payload_len);
+        refresh_calibration();
+        if (calibration_rejected) return finish_packet(0);
+
+        if (model != MODEL_PANDAR64 || !Pandar64Layout::check(payload, payload_len)) {
+            // model khac / format linear / header loi: qua parser thuong roi chieu
+            // (append_packet() dem va do thoi gian packet nay, bo dem cua duong nay bo qua)
+            timer.cancel();
+            pending.clear();
+            fused_scratch.clear();
+            append_packet(packet, fused_scratch);
+            size_t n = fused_scratch.size();
+            for (size_t first = 0, m; first < n; first += m) {
+                // 1 lan goi fn cho moi azimuth (toi da 64 diem)
+                m = 1;
+                while (first + m < n && m < PANDAR64_LASERS &&
+                       fused_scratch.azimuth[first + m] == fused_scratch.azimuth[first]) {
+                    m++;
+                }
+                view.apply(fused_scratch.x.data() + first, fused_scratch.y.data() + first, m, block_x, block_y);
+                fn(static_cast<const float*>(block_x), static_cast<const float*>(block_y), m,
+                   fused_scratch.azimuth[first]);
             }
+            return n;
         }
-    } else {
-        // --- Format linear block ---
-        parse_blocks_linear(payload, payload_len, cloud);
-    }
 
-    return cloud;
-}
+        const float dist_unit = 0.004f;
+        const uint8_t* ptr = payload + 8;
+        const uint8_t* end = payload + payload_len;
+        const BlockTables tables { xy_cos, xy_sin, sin_elev };
+        const BlockOutput out { block_x, block_y, block_z, block_intensity, block_laser, &packet_zeros };
+        size_t total = 0;
+        size_t records = 0;
+        packet_zeros = 0;
+        return_mode = layout_return_mode<Pandar64Layout>(payload, payload_len);
+
+        for (int blk = 0; blk < 6; ++blk, ptr += 2 + PANDAR64_BLOCK_BYTES) {
+            if (ptr + 2 > end) break;
+            if (return_mode_is_dual(return_mode) && !return_selected(return_selection, block_return(return_mode, blk))) {
+                continue;
+            }
 
+            uint16_t az_raw = ptr[0] | (ptr[1] << 8);
+            uint32_t az_idx = az_raw % AZIMUTH_STEPS;
+            const float cos_az = az_lut->cos_az[az_idx];
+            const float sin_az = az_lut->sin_az[az_idx];
+            const uint8_t* rec = ptr + 2;
+
+            // cos/sin cua (azimuth + goc xoay), nhan -scale: decoder tra ve -scale * R * (x, y)
+            const float c = -view.scale * (cos_az * view.cos_rot - sin_az * view.sin_rot);
+            const float s = -view.scale * (sin_az * view.cos_rot + cos_az * view.sin_rot);
+
+            int count;
+            size_t remain = end > rec ? static_cast<size_t>(end - rec) : 0;
+            if (remain >= PANDAR64_BLOCK_BYTES + PANDAR64_SIMD_SLACK) {
+                count = decode_block(rec, PANDAR64_LASERS, c, s, dist_unit, MIN_RANGE_M, tables, out);
+                records += PANDAR64_LASERS;
+            } else {
+                int channels = static_cast<int>(std::min<size_t>(PANDAR64_LASERS, remain / PANDAR64_RECORD_BYTES));
+                count = decode_block_scalar(rec, channels, c, s, dist_unit, MIN_RANGE_M, tables, out);
+                records += channels;
+                if (channels < PANDAR64_LASERS) pending[PARSE_TRUNCATED_BLOCKS]++;
+            }
 
-private:
-    float elevation_table[64];
-    float azimuth_table[64];
-
-    void init_vertical_angles() {
-        const float tbl[64] = {
-            14.882f, 11.032f, 8.059f, 5.057f, 3.04f, 1.854f, 0.686f, 0.514f,
-            0.348f, 0.177f, 0.01f, -0.157f, -0.324f, -0.491f, -0.658f, -0.825f,
-            -0.992f, -1.159f, -1.326f, -1.493f, -1.660f, -1.827f, -1.994f, -2.161f,
-            -2.328f, -2.495f, -2.662f, -2.829f, -2.996f, -3.163f, -3.330f, -3.497f,
-            -3.664f, -3.831f, -3.998f, -4.165f, -4.332f, -4.499f, -4.666f, -4.833f,
-            -5.000f, -5.167f, -5.334f, -5.501f, -5.668f, -5.835f, -6.002f, -6.169f,
-            -6.336f, -6.503f, -6.670f, -6.837f, -7.004f, -7.171f, -8.233f, -9.234f,
-            -10.059f, -11.206f, -12.18f, -13.148f, -14.104f, -18.889f, -24.897f
-        };
-        std::memcpy(elevation_table, tbl, sizeof(tbl));
-    }
-
-    void init_azimuth_table() {
-        const float tbl[64] = {
-            -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, 3.125f,
-            5.208f, -5.208f, -3.125f, -1.042f, 1.042f, 3.125f, 5.208f, -5.208f,
-            -3.125f, -1.042f, 1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f,
-            1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f, -1.042f, -1.042f,
-            -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f,
-            -3.125f, -1.042f, 1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f,
-            1.042f, 3.125f, 5.208f, -5.208f, -3.125f, -1.042f, -1.042f, -1.042f,
-            -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f, -1.042f
-        };
-        std::memcpy(azimuth_table, tbl, sizeof(tbl));
+            for (int k = 0; k < count; k++) {
+                block_x[k] += view.offset_x;
+                block_y[k] += view.offset_y;
+            }
+            fn(static_cast<const float*>(block_x), static_cast<const float*>(block_y),
+               static_cast<size_t>(count), static_cast<uint16_t>(az_idx));
+            total += count;
+        }
+        count_rejects(records, total);
+        return finish_packet(total);
     }
 
+    // Azimuth (0.01 deg) of every block of a packet, without decoding the points.
+    // Returns the number of blocks (0 for packets that are not of the stream's model).
+    size_t block_azimuths(const PCAP_PacketView &packet, uint16_t* azimuths, size_t max_blocks) {
+        const uint8_t* payload = nullptr;
+        size_t payload_len = 0;
+        if (!packet.packet_data ||
+            !extract_udp_payload(packet.packet_data, packet.packet_header.capture_length, payload, payload_len)) {
+            return 0;
+        }
+        if (model == MODEL_AUTO) detect_stream_model(payload, payload_len);
+        if (!azimuths_layout_fn) return 0;
+        uint16_t az[LIDAR_MAX_BLOCKS];
+        size_t n = std::min((this->*azimuths_layout_fn)(payload, payload_len, az), max_blocks);
+        std::copy(az, az + n, azimuths);
+        return n;
+    }
+
+    // project_packet() vao raster dem diem moi pixel
+    inline size_t rasterize_packet(const PCAP_PacketView &packet, const ViewportTransform &view,
+                                   RasterBuffer &raster) {
+        return project_packet(packet, view, [&](const float* sx, const float* sy, size_t n, uint16_t) {
+            raster.add(sx, sy, n);
+        });
+    }
+
+    // UDP payload of an Ethernet (optionally 802.1Q) frame. counts != nullptr: frames without
+    // UDP payload and VLAN tags are counted there
     bool extract_udp_payload(const u_char* packet_data, size_t caplen,
-                             const uint8_t*& payload, size_t& payload_len) {
+                             const uint8_t*& payload, size_t& payload_len, ParseCounts* counts = nullptr) {
+        bool vlan = false;
+        bool ok = find_udp_payload(packet_data, caplen, payload, payload_len, vlan);
+        if (counts) {
+            if (vlan) (*counts)[PARSE_VLAN]++;
+            if (!ok) (*counts)[PARSE_NON_UDP]++;
+        }
+        return ok;
+    }
+
+    static bool find_udp_payload(const u_char* packet_data, size_t caplen,
+                                 const uint8_t*& payload, size_t& payload_len, bool& vlan) {
         payload = nullptr;
         payload_len = 0;
         if (!packet_data || caplen < 42) return false;
@@ -145,6 +319,7 @@ private:
         size_t ip_offset = eth_header_len;
 
         if (ethertype == 0x8100) {  // VLAN
+            vlan = true;
             if (caplen < eth_header_len + 4) return false;
             ethertype = (packet_data[16] << 8) | packet_data[17];
             ip_offset += 4;
@@ -173,9 +348,258 @@ private:
         return payload_len > 0;
     }
 
+
+private:
+    // Derived per-laser tables (from AngleCorrection), so a point costs only multiply-adds:
+    //   cos(az + off) = cos(az)cos(off) - sin(az)sin(off)
+    //   x = d * (cos_az * xy_cos[l] - sin_az * xy_sin[l])
+    //   y = d * (sin_az * xy_cos[l] + cos_az * xy_sin[l])
+    //   z = d * sin_elev[l]
+    // with xy_cos = cos(elev)cos(off), xy_sin = cos(elev)sin(off).
+    alignas(32) float xy_cos[64];
+    alignas(32) float xy_sin[64];
+    alignas(32) float sin_elev[64];
+    const AzimuthLUT* az_lut;
+    std::shared_ptr<CalibrationStore> calibration;
+    uint64_t calibration_generation {0};
+
+    SimdLevel simd_level {SIMD_SCALAR};
+    BlockDecodeFn decode_block {decode_block_scalar};
+
+    // stream model: instantiation of the layout templates picked by set_model()
+    typedef bool (Pandar64Parser::*AppendLayoutFn)(const uint8_t*, size_t, double, PointCloudSoA&);
+    typedef size_t (Pandar64Parser::*AzimuthLayoutFn)(const uint8_t*, size_t, uint16_t*);
+    LidarModel model {MODEL_AUTO};
+    AppendLayoutFn append_layout_fn {nullptr};
+    AzimuthLayoutFn azimuths_layout_fn {nullptr};
+    BlockDecodeFn decode_tail {decode_block_scalar};   // truncated blocks
+    bool calibration_rejected {false};     // calibration file does not fit the model: decode nothing
+    ReturnSelection return_selection {RETURNS_BOTH};
+    uint8_t return_mode {RETURN_MODE_STRONGEST};
+    PacketTail tail;
+
+    // counters: tallied per packet in `pending`, published by finish_packet()
+    std::shared_ptr<ParseStats> stats;
+    ParseCounts pending;
+    uint32_t packet_zeros {0};             // BlockOutput::zeros of the current packet
+
+    // 1 block cua duong project_packet(), nam gon trong L1
+    alignas(32) float block_x[PANDAR64_LASERS];
+    alignas(32) float block_y[PANDAR64_LASERS];
+    alignas(32) float block_z[PANDAR64_LASERS];
+    uint8_t block_intensity[PANDAR64_LASERS];
+    uint8_t block_laser[PANDAR64_LASERS];
+    PointCloudSoA fused_scratch;          // chi dung cho format linear
+
+    // pick up a calibration published since the last packet
+    inline void refresh_calibration() {
+        if (!calibration) return;
+        const uint64_t g = calibration->generation();
+        if (g == calibration_generation) return;
+        calibration_generation = g;
+        if (!calibration->has_file()) return;   // store default: keep the model's own angles
+        std::shared_ptr<const AngleCorrection> c = calibration->get();
+        // wrong laser count: reported by require_lasers(), the stream decodes nothing
+        calibration_rejected = model != MODEL_AUTO && c->lasers != model_lasers(model);
+        if (!calibration_rejected) set_angle_correction(*c);
+    }
+
+    // model known: the calibration file must have its laser count (now and on every reload)
+    inline void require_calibration_lasers() {
+        if (calibration && model != MODEL_AUTO) calibration->require_lasers(model_lasers(model), model_name(model));
+    }
+
+    // End of one packet: publish its tally. Returns n (points of the packet).
+    inline size_t finish_packet(size_t n) {
+        pending[PARSE_PACKETS]++;
+        if (n == 0) pending[PARSE_EMPTY_PACKETS]++;
+        if (stats) stats->add(pending);
+        pending.clear();
+        return n;
+    }
+
+    // records decoded - points kept = zero distance (counted by the decoder) + under min range
+    inline void count_rejects(size_t records, size_t points) {
+        pending[PARSE_ZERO_DISTANCE] += packet_zeros;
+        pending[PARSE_MIN_RANGE] += records - points - packet_zeros;
+    }
+
+    // Lock the stream to the model of its first recognised packet
+    inline void detect_stream_model(const uint8_t* payload, size_t payload_len) {
+        LidarModel m = detect_model(payload, payload_len);
+        if (m != MODEL_AUTO) set_model(m);
+    }
+
+    template <typename Layout>
+    void use_layout() {
+        append_layout_fn = &Pandar64Parser::append_layout<Layout>;
+        azimuths_layout_fn = &Pandar64Parser::azimuths_layout<Layout>;
+    }
+
+    void select_decoder() {
+        switch (model) {
+            case MODEL_PANDAR40P:
+                decode_block = select_block_decoder_t<Pandar40PLayout::lasers, Pandar40PLayout::record_bytes>(simd_level);
+                decode_tail = decode_records_scalar<Pandar40PLayout::record_bytes>;
+                break;
+            case MODEL_PANDARXT32:
+                decode_block = select_block_decoder_t<PandarXT32Layout::lasers, PandarXT32Layout::record_bytes>(simd_level);
+                decode_tail = decode_records_scalar<PandarXT32Layout::record_bytes>;
+                break;
+            case MODEL_VLP16:
+                decode_block = select_block_decoder_t<VLP16Layout::lasers, VLP16Layout::record_bytes>(simd_level);
+                decode_tail = decode_records_scalar<VLP16Layout::record_bytes>;
+                break;
+            default:
+                decode_block = select_block_decoder(simd_level);
+                decode_tail = decode_block_scalar;
+                break;
+        }
+    }
+
+    // Block azimuths of a packet of this layout; stops at the first missing / bad block
+    template <typename Layout>
+    size_t azimuths_layout(const uint8_t* payload, size_t payload_len, uint16_t* az) {
+        if (!Layout::check(payload, payload_len)) return 0;
+        constexpr int block_bytes = layout_block_bytes<Layout>();
+        const uint8_t* ptr = payload + Layout::header_bytes;
+        const uint8_t* end = payload + payload_len;
+        size_t n = 0;
+        for (int blk = 0; blk < Layout::blocks; ++blk, ptr += block_bytes) {
+            if (ptr + Layout::flag_bytes + 2 > end) break;
+            if (Layout::flag_bytes && !(ptr[0] == 0xFF && ptr[1] == 0xEE)) break;
+            az[n++] = static_cast<uint16_t>((ptr[Layout::flag_bytes] | (ptr[Layout::flag_bytes + 1] << 8)) % AZIMUTH_STEPS);
+        }
+        return n;
+    }
+
+    /**
+     * Giai ma 1 packet cua layout: so block, so kenh, kich thuoc record deu la hang so
+     * luc bien dich. Tra ve false neu packet khong thuoc layout nay.
+     * Moi diem co thoi gian rieng: stamp (luc bat packet, ngay sau lan ban cuoi) lui ve
+     * lan ban dau tien, cong do lech cua block / firing / kenh.
+     */
+    template <typename Layout>
+    bool append_layout(const uint8_t* payload, size_t payload_len, double stamp, PointCloudSoA& cloud) {
+        uint16_t az[LIDAR_MAX_BLOCKS];
+        const int blocks = static_cast<int>(azimuths_layout<Layout>(payload, payload_len, az));
+        if (blocks == 0) return false;
+
+        constexpr int block_bytes = layout_block_bytes<Layout>();
+        constexpr int firing_bytes = Layout::lasers * Layout::record_bytes;
+        const uint8_t* end = payload + payload_len;
+        const BlockTables tables { xy_cos, xy_sin, sin_elev };
+        cloud.reserve_extra(layout_points<Layout>());
+
+        // dual return: blocks in pairs (last, strongest) of the same firing
+        return_mode = layout_return_mode<Layout>(payload, payload_len);
+        const int pair = return_mode_is_dual(return_mode) ? 2 : 1;
+
+        const size_t first_point = cloud.size();
+        size_t records = 0;
+        packet_zeros = 0;
+
+        const double first_firing = stamp - layout_span_us<Layout>(pair) * 1e-6;
+        tail = PacketTail();
+        Layout::read_tail(payload, payload_len, stamp, tail);
+        if (!std::isnan(tail.sensor_time)) tail.clock_offset = tail.sensor_time - first_firing;
+        constexpr double laser_s = Layout::laser_us * 1e-6;
+
+        for (int blk = 0; blk < blocks; ++blk) {
+            const uint8_t ret = block_return(return_mode, blk);
+            if (pair == 2 && !return_selected(return_selection, ret)) continue;
+
+            const uint8_t* rec = payload + Layout::header_bytes + blk * block_bytes + Layout::flag_bytes + 2;
+            for (int f = 0; f < Layout::firings; ++f, rec += firing_bytes) {
+                uint32_t az_idx = az[blk];
+                if (f > 0) {
+                    // later firings: interpolated towards the next firing time (last one: previous step)
+                    int step = 0;
+                    if (blk + pair < blocks) step = (az[blk + pair] - az[blk] + AZIMUTH_STEPS) % AZIMUTH_STEPS;
+                    else if (blk >= pair) step = (az[blk] - az[blk - pair] + AZIMUTH_STEPS) % AZIMUTH_STEPS;
+                    az_idx = (az_idx + step * f / Layout::firings) % AZIMUTH_STEPS;
+                }
+                const float cos_az = az_lut->cos_az[az_idx];
+                const float sin_az = az_lut->sin_az[az_idx];
+                const double firing_time = first_firing + ((blk / pair) * Layout::block_us + f * Layout::firing_us) * 1e-6;
+
+                // decoder ghi thang vao cac cot cua cloud, sau diem cuoi hien tai
+                const size_t n0 = cloud.size();
+                const BlockOutput out {
+                    cloud.x.data() + n0, cloud.y.data() + n0, cloud.z.data() + n0,
+                    cloud.intensity.data() + n0, cloud.laser_id.data() + n0, &packet_zeros
+                };
+
+                // ca firing giai ma 1 lan; block bi cat ngan -> duong scalar
+                int count;
+                size_t remain = end > rec ? static_cast<size_t>(end - rec) : 0;
+                if (remain >= firing_bytes + PANDAR64_SIMD_SLACK) {
+                    count = decode_block(rec, Layout::lasers, cos_az, sin_az, Layout::dist_unit, MIN_RANGE_M, tables, out);
+                    records += Layout::lasers;
+                } else {
+                    int channels = static_cast<int>(std::min<size_t>(Layout::lasers, remain / Layout::record_bytes));
+                    count = decode_tail(rec, channels, cos_az, sin_az, Layout::dist_unit, MIN_RANGE_M, tables, out);
+                    records += channels;
+                    if (channels < Layout::lasers) pending[PARSE_TRUNCATED_BLOCKS]++;
+                }
+
+                std::fill_n(cloud.azimuth.data() + n0, count, static_cast<uint16_t>(az_idx));
+                const uint8_t* laser = cloud.laser_id.data() + n0;
+                double* ts = cloud.timestamp.data() + n0;
+                for (int k = 0; k < count; k++) ts[k] = firing_time + laser[k] * laser_s;
+                std::fill_n(cloud.return_index.data() + n0, count, ret);
+                cloud.resize(n0 + count);
+            }
+        }
+        count_rejects(records, cloud.size() - first_point);
+        return true;
+    }
+
+    // --- trong parse_packet ---
+    // Decode one packet and append its points to cloud. Returns the number of points added.
+    size_t append_packet(const PCAP_PacketView &packet, PointCloudSoA &cloud) {
+        StageTimer timer(STAGE_PARSE);
+        const size_t first = cloud.size();
+
+        const uint8_t* payload = nullptr;
+        size_t payload_len = 0;
+        if (!extract_udp_payload(packet.packet_data, packet.packet_header.capture_length,
+                                 payload, payload_len, &pending)) {
+            return finish_packet(0);
+        }
+
+        if (payload_len < 4) {
+            pending[PARSE_INVALID_SOP]++;
+            return finish_packet(0);
+        }
+        if (model == MODEL_AUTO) detect_stream_model(payload, payload_len);
+        refresh_calibration();
+        if (calibration_rejected) return finish_packet(0);
+
+        const double stamp = packet.packet_header.timestamp_second +
+                             packet.packet_header.timestamp_microsecond * 1e-6;
+
+        if (append_layout_fn && (this->*append_layout_fn)(payload, payload_len, stamp, cloud)) {
+            return finish_packet(cloud.size() - first);
+        }
+
+        // not a packet of the stream's model: counted, never logged per packet
+        tail = PacketTail();
+        uint16_t sop = payload[0] | (payload[1] << 8);
+        if (sop == 0xFFEE) {
+            pending[PARSE_BAD_HEADER]++;   // laser_num = payload[2], block_num = payload[3]
+            return finish_packet(0);
+        }
+        // --- Format linear block --- (no start-of-packet: invalid only if nothing decodes)
+        parse_blocks_linear(payload, payload_len, stamp, cloud);
+        pending[cloud.size() > first ? PARSE_LINEAR_FORMAT : PARSE_INVALID_SOP]++;
+
+        return finish_packet(cloud.size() - first);
+    }
+
     // Fallback cho linear parsing nếu không có header
     void parse_blocks_linear(const uint8_t* payload, size_t payload_len,
-                             std::vector<PointXYZI>& cloud) {
+                             double stamp, PointCloudSoA& cloud) {
         if (!payload || payload_len < 6) return;
         float dist_unit = 0.004f;
         size_t i = 0;
@@ -188,7 +612,9 @@ private:
             }
 
             uint16_t raw_az = payload[i+2] | (payload[i+3] << 8);
-            float azimuth_deg = raw_az / 100.0f;
+            uint32_t az_idx = raw_az % AZIMUTH_STEPS;
+            const float cos_az = az_lut->cos_az[az_idx];
+            const float sin_az = az_lut->sin_az[az_idx];
             size_t pos = i + 4;
             size_t t = 0;
             while (pos + 2 < payload_len) {
@@ -196,21 +622,20 @@ private:
                 uint8_t intensity = payload[pos+2];
                 pos += 3;
                 if (raw_dist == 0) {
+                    pending[PARSE_ZERO_DISTANCE]++;
                     ++t;
                     continue;
                 }
                 float distance_m = raw_dist * dist_unit;
                 size_t laser_id = t % 64;
-                float vert_rad = elevation_table[laser_id] * static_cast<float>(M_PI) / 180.0f;
-                float az_offset = azimuth_table[laser_id];
-                float full_az_rad = (azimuth_deg + az_offset) * static_cast<float>(M_PI) / 180.0f;
-
-                PointXYZI p;
-                p.x = distance_m * std::cos(vert_rad) * std::cos(full_az_rad);
-                p.y = distance_m * std::cos(vert_rad) * std::sin(full_az_rad);
-                p.z = distance_m * std::sin(vert_rad);
-                p.intensity = intensity;
-                cloud.push_back(p);
+                const float kc = xy_cos[laser_id];
+                const float ks = xy_sin[laser_id];
+
+                cloud.push_back(distance_m * (cos_az * kc - sin_az * ks),
+                                distance_m * (sin_az * kc + cos_az * ks),
+                                distance_m * sin_elev[laser_id],
+                                intensity, static_cast<uint8_t>(laser_id),
+                                static_cast<uint16_t>(az_idx), stamp);
                 ++t;
             }
             i = pos - 1;
@@ -0,0 +1,192 @@
+#pragma once
+//==============================================
+// Bounded single-producer / single-consumer ring of packet slots
+// The capture thread copies each packet into a preallocated fixed-size slot;
+// the processing thread reads it in place (front/pop). Indices live on their
+// own cache lines. When full, the producer either waits (OVERFLOW_BLOCK) or
+// discards the oldest unread packet (OVERFLOW_DROP_OLDEST).
+//==============================================
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "PCAP_capture.h"
+
+#define PACKET_RING_SLOTS     4096
+#define PACKET_RING_SLOT_SIZE 2048      // bytes per slot, longer packets are truncated
+
+enum OverflowPolicy {
+    OVERFLOW_BLOCK = 0,                 // producer waits for room
+    OVERFLOW_DROP_OLDEST = 1            // producer discards the oldest unread packet
+};
+
+class PacketRing {
+private:
+    struct SlotHeader {
+        PCAP_Header header;
+    };
+
+    const size_t slot_count;
+    const size_t slot_size;
+    const OverflowPolicy policy;
+    std::vector<SlotHeader> headers;
+    std::vector<u_char> storage;
+
+    // consumer side: next packet to read. The producer also advances it when dropping.
+    alignas(64) std::atomic<uint64_t> head {0};
+    // slot the consumer is reading + 1 (0 = none); the producer never overwrites it
+    alignas(64) std::atomic<uint64_t> reading {0};
+    uint64_t held {0};
+    // producer side
+    alignas(64) std::atomic<uint64_t> tail {0};
+    std::atomic<uint64_t> high_water {0};
+    std::atomic<uint64_t> overflow_count {0};   // ring was full on push
+    std::atomic<uint64_t> dropped_count {0};    // packets lost because of it
+    std::atomic<uint64_t> truncated_count {0};
+    std::atomic<bool> closed {false};
+
+    inline u_char* slot_data(uint64_t seq) {
+        return storage.data() + (seq % slot_count) * slot_size;
+    }
+
+    // oldest index the producer must not overwrite
+    inline uint64_t oldest_in_use() const {
+        uint64_t h = head.load(std::memory_order_seq_cst);
+        uint64_t r = reading.load(std::memory_order_seq_cst);
+        return (r != 0 && r - 1 < h) ? r - 1 : h;
+    }
+
+public:
+    explicit PacketRing(size_t slots = PACKET_RING_SLOTS,
+                        OverflowPolicy overflow = OVERFLOW_BLOCK,
+                        size_t slot_bytes = PACKET_RING_SLOT_SIZE)
+        : slot_count(std::max<size_t>(slots, 2)),
+          slot_size(slot_bytes),
+          policy(overflow),
+          headers(slot_count),
+          storage(slot_count * slot_bytes) {}
+
+    PacketRing(const PacketRing&) = delete;
+    PacketRing& operator=(const PacketRing&) = delete;
+
+    //==========================================================================
+    // Producer
+    //==========================================================================
+    // Copy one packet into the ring. Returns false if the packet was dropped.
+    bool push(const PCAP_PacketView& packet) {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+
+        if (t - oldest_in_use() >= slot_count) {
+            overflow_count.fetch_add(1, std::memory_order_relaxed);
+            if (policy == OVERFLOW_BLOCK) {
+                int spins = 0;
+                while (t - oldest_in_use() >= slot_count) {
+                    if (closed.load(std::memory_order_relaxed)) return false;
+                    if (++spins < 64) std::this_thread::yield();
+                    else std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            } else {
+                // drop the oldest unread packet; if the consumer has just
+                // started reading it, drop the incoming one instead
+                // only while still full: the consumer may have caught up meanwhile
+                uint64_t h = head.load(std::memory_order_seq_cst);
+                bool advanced = false;
+                while (t - h >= slot_count) {
+                    if (head.compare_exchange_weak(h, h + 1, std::memory_order_seq_cst)) {
+                        advanced = true;
+                        break;
+                    }
+                }
+                if (t - oldest_in_use() >= slot_count) {
+                    // consumer still gets packet h, the incoming one is lost instead
+                    dropped_count.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (advanced) dropped_count.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        uint32_t caplen = packet.packet_header.capture_length;
+        if (caplen > slot_size) {
+            caplen = static_cast<uint32_t>(slot_size);
+            truncated_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        SlotHeader& sh = headers[t % slot_count];
+        sh.header = packet.packet_header;
+        sh.header.capture_length = caplen;
+        std::memcpy(slot_data(t), packet.packet_data, caplen);
+
+        tail.store(t + 1, std::memory_order_release);
+
+        uint64_t depth = t + 1 - head.load(std::memory_order_relaxed);
+        if (depth > high_water.load(std::memory_order_relaxed))
+            high_water.store(depth, std::memory_order_relaxed);
+        return true;
+    }
+
+    // No more packets will be pushed; the consumer drains what is left
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+    //==========================================================================
+    // Consumer
+    //==========================================================================
+    // Oldest unread packet, read in place. Valid until pop(). Returns false if empty.
+    bool front(PCAP_PacketView& view) {
+        while (true) {
+            uint64_t h = head.load(std::memory_order_seq_cst);
+            if (h == tail.load(std::memory_order_acquire)) return false;
+
+            reading.store(h + 1, std::memory_order_seq_cst);
+            if (head.load(std::memory_order_seq_cst) != h) continue;   // dropped meanwhile
+
+            held = h;
+            view.packet_header = headers[h % slot_count].header;
+            view.packet_data = slot_data(h);
+            return true;
+        }
+    }
+
+    // front() with waiting: returns false on timeout or when closed and empty
+    bool wait_front(PCAP_PacketView& view, int timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        int spins = 0;
+        while (!front(view)) {
+            if (closed.load(std::memory_order_acquire) && empty()) return false;
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            if (++spins < 64) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+
+    // Release the packet returned by front()
+    void pop() {
+        uint64_t h = held;
+        head.compare_exchange_strong(h, held + 1, std::memory_order_seq_cst);
+        reading.store(0, std::memory_order_seq_cst);
+    }
+
+    //==========================================================================
+    // Statistics
+    //==========================================================================
+    inline size_t capacity() const { return slot_count; }
+    inline size_t size() const {
+        return static_cast<size_t>(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+    }
+    inline bool empty() const { return size() == 0; }
+    inline bool is_closed() const { return closed.load(std::memory_order_acquire); }
+    inline uint64_t high_water_mark() const { return high_water.load(std::memory_order_relaxed); }
+    inline uint64_t overflows() const { return overflow_count.load(std::memory_order_relaxed); }
+    inline uint64_t dropped() const { return dropped_count.load(std::memory_order_relaxed); }
+    inline uint64_t truncated() const { return truncated_count.load(std::memory_order_relaxed); }
+};
+
+#endif // PACKET_RING_H
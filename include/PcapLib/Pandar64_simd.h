@@ -0,0 +1,325 @@
+#pragma once
+//==============================================
+// Block decoders, specialised per sensor model at compile time
+// One call decodes a whole block of (distance, intensity[, reserved])
+// records, applies distance unit, zero and min-range masks, projects to
+// x/y/z and writes the surviving points compacted straight into the cloud
+// columns. Channel count and record size are template parameters, so every
+// loop has a constant bound (Pandar64: 64 x 3 bytes, XT32: 32 x 4 bytes ...).
+// Scalar, SSE4.1 and AVX2 variants give bit-identical results (same
+// operation order, no FMA contraction - see -ffp-contract=off in CMake).
+//==============================================
+#ifndef PANDAR64_SIMD_H
+#define PANDAR64_SIMD_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PANDAR64_X86 1
+#endif
+
+#define PANDAR64_LASERS        64
+#define PANDAR64_RECORD_BYTES  3
+#define PANDAR64_BLOCK_BYTES   (PANDAR64_LASERS * PANDAR64_RECORD_BYTES)
+#define PANDAR64_SIMD_SLACK    4     // SIMD loads read up to 4 bytes past the block
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE41  = 1,
+    SIMD_AVX2   = 2
+};
+
+// Destination columns for one block. The decoders may write (but not count)
+// up to one element per channel of the block from these pointers, never more.
+// *zeros is incremented by the number of records without echo (distance 0);
+// the other rejected records are the ones under min_range.
+struct BlockOutput {
+    float* x;
+    float* y;
+    float* z;
+    uint8_t* intensity;
+    uint8_t* laser_id;
+    uint32_t* zeros;
+};
+
+// Per-laser projection tables owned by the parser (see AngleCorrection::derive)
+struct BlockTables {
+    const float* xy_cos;
+    const float* xy_sin;
+    const float* sin_elev;
+};
+
+typedef int (*BlockDecodeFn)(const uint8_t* records, int channels,
+                             float cos_az, float sin_az,
+                             float dist_unit, float min_range,
+                             const BlockTables& tables, const BlockOutput& out);
+
+//==========================================================================
+// Scalar reference, also used for truncated blocks (channels = records present)
+//==========================================================================
+template <int Stride>
+inline int decode_records_scalar(const uint8_t* records, int channels,
+                                 float cos_az, float sin_az,
+                                 float dist_unit, float min_range,
+                                 const BlockTables& tables, const BlockOutput& out)
+{
+    int n = 0;
+    uint32_t zeros = 0;
+    const uint8_t* ptr = records;
+    for (int ch = 0; ch < channels; ++ch, ptr += Stride) {
+        uint16_t raw_dist = ptr[0] | (ptr[1] << 8);
+        if (raw_dist == 0) {
+            zeros++;
+            continue;
+        }
+        float distance_m = static_cast<float>(raw_dist) * dist_unit;
+        if (!(distance_m >= min_range)) continue;
+
+        const float kc = tables.xy_cos[ch];
+        const float ks = tables.xy_sin[ch];
+        out.x[n] = distance_m * ((cos_az * kc) - (sin_az * ks));
+        out.y[n] = distance_m * ((sin_az * kc) + (cos_az * ks));
+        out.z[n] = distance_m * tables.sin_elev[ch];
+        out.intensity[n] = ptr[2];
+        out.laser_id[n] = static_cast<uint8_t>(ch);
+        n++;
+    }
+    *out.zeros += zeros;
+    return n;
+}
+
+// whole block, constant bound
+template <int Lasers, int Stride>
+inline int decode_block_scalar_t(const uint8_t* records, int /*channels*/,
+                                 float cos_az, float sin_az,
+                                 float dist_unit, float min_range,
+                                 const BlockTables& tables, const BlockOutput& out)
+{
+    return decode_records_scalar<Stride>(records, Lasers, cos_az, sin_az, dist_unit, min_range, tables, out);
+}
+
+inline int decode_block_scalar(const uint8_t* records, int channels,
+                               float cos_az, float sin_az,
+                               float dist_unit, float min_range,
+                               const BlockTables& tables, const BlockOutput& out)
+{
+    return decode_records_scalar<PANDAR64_RECORD_BYTES>(records, channels, cos_az, sin_az,
+                                                        dist_unit, min_range, tables, out);
+}
+
+#ifdef PANDAR64_X86
+
+// Shuffle controls that move the lanes selected by a movemask to the front
+struct LeftPackLUT {
+    alignas(16) uint8_t sse[16][16];   // 4 x 32-bit lanes, byte shuffle for pshufb
+    uint64_t avx[256];                 // 8 x 32-bit lanes, one lane index per byte
+
+    LeftPackLUT() {
+        for (int m = 0; m < 16; m++) {
+            int k = 0;
+            std::memset(sse[m], 0x80, 16);
+            for (int lane = 0; lane < 4; lane++) {
+                if (!(m & (1 << lane))) continue;
+                for (int b = 0; b < 4; b++) sse[m][k * 4 + b] = static_cast<uint8_t>(lane * 4 + b);
+                k++;
+            }
+        }
+        for (int m = 0; m < 256; m++) {
+            uint64_t v = 0;
+            int k = 0;
+            for (int lane = 0; lane < 8; lane++) {
+                if (m & (1 << lane)) v |= static_cast<uint64_t>(lane) << (8 * k++);
+            }
+            avx[m] = v;
+        }
+    }
+
+    static const LeftPackLUT& instance() {
+        static const LeftPackLUT lut;
+        return lut;
+    }
+};
+
+//==========================================================================
+// SSE4.1: 4 records (4 * Stride bytes) per step
+//==========================================================================
+template <int Lasers, int Stride>
+__attribute__((target("sse4.1")))
+inline int decode_block_sse41_t(const uint8_t* records, int /*channels*/,
+                                float cos_az, float sin_az,
+                                float dist_unit, float min_range,
+                                const BlockTables& tables, const BlockOutput& out)
+{
+    static_assert(Lasers % 4 == 0 && (Stride == 3 || Stride == 4), "unsupported block layout");
+    const LeftPackLUT& lut = LeftPackLUT::instance();
+    const __m128i shuf_dist = _mm_setr_epi8(0, 1, -1, -1, Stride, Stride + 1, -1, -1,
+                                            2 * Stride, 2 * Stride + 1, -1, -1, 3 * Stride, 3 * Stride + 1, -1, -1);
+    const __m128i shuf_int  = _mm_setr_epi8(2, -1, -1, -1, Stride + 2, -1, -1, -1,
+                                            2 * Stride + 2, -1, -1, -1, 3 * Stride + 2, -1, -1, -1);
+    const __m128 vca = _mm_set1_ps(cos_az);
+    const __m128 vsa = _mm_set1_ps(sin_az);
+    const __m128 vunit = _mm_set1_ps(dist_unit);
+    const __m128 vmin = _mm_set1_ps(min_range);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lane_ids = _mm_setr_epi32(0, 1, 2, 3);
+
+    int n = 0;
+    uint32_t zeros = 0;
+    for (int ch = 0; ch < Lasers; ch += 4) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(records + ch * Stride));
+        __m128i dist_i = _mm_shuffle_epi8(raw, shuf_dist);
+        __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dist_i), vunit);
+        __m128 is_zero = _mm_castsi128_ps(_mm_cmpeq_epi32(dist_i, zero));
+        zeros += __builtin_popcount(static_cast<unsigned>(_mm_movemask_ps(is_zero)));
+        __m128 valid = _mm_andnot_ps(is_zero, _mm_cmpge_ps(d, vmin));
+        int mask = _mm_movemask_ps(valid);
+        if (!mask) continue;
+
+        const __m128 kc = _mm_load_ps(tables.xy_cos + ch);
+        const __m128 ks = _mm_load_ps(tables.xy_sin + ch);
+        const __m128 se = _mm_load_ps(tables.sin_elev + ch);
+        __m128 x = _mm_mul_ps(d, _mm_sub_ps(_mm_mul_ps(vca, kc), _mm_mul_ps(vsa, ks)));
+        __m128 y = _mm_mul_ps(d, _mm_add_ps(_mm_mul_ps(vsa, kc), _mm_mul_ps(vca, ks)));
+        __m128 z = _mm_mul_ps(d, se);
+
+        const __m128i perm = _mm_load_si128(reinterpret_cast<const __m128i*>(lut.sse[mask]));
+        _mm_storeu_ps(out.x + n, _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(x), perm)));
+        _mm_storeu_ps(out.y + n, _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(y), perm)));
+        _mm_storeu_ps(out.z + n, _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(z), perm)));
+
+        __m128i inten = _mm_shuffle_epi8(_mm_shuffle_epi8(raw, shuf_int), perm);
+        __m128i laser = _mm_shuffle_epi8(_mm_add_epi32(lane_ids, _mm_set1_epi32(ch)), perm);
+        // both columns in one pack: bytes 0..3 intensity, 4..7 laser id
+        __m128i packed = _mm_packus_epi16(_mm_packus_epi32(inten, laser), zero);
+        int32_t bytes[2] = { _mm_cvtsi128_si32(packed), _mm_extract_epi32(packed, 1) };
+        std::memcpy(out.intensity + n, &bytes[0], sizeof(int32_t));
+        std::memcpy(out.laser_id + n, &bytes[1], sizeof(int32_t));
+
+        n += __builtin_popcount(static_cast<unsigned>(mask));
+    }
+    *out.zeros += zeros;
+    return n;
+}
+
+//==========================================================================
+// AVX2: 8 records per step, one group of 4 records per 128-bit lane
+//==========================================================================
+template <int Lasers, int Stride>
+__attribute__((target("avx2")))
+inline int decode_block_avx2_t(const uint8_t* records, int /*channels*/,
+                               float cos_az, float sin_az,
+                               float dist_unit, float min_range,
+                               const BlockTables& tables, const BlockOutput& out)
+{
+    static_assert(Lasers % 8 == 0 && (Stride == 3 || Stride == 4), "unsupported block layout");
+    const LeftPackLUT& lut = LeftPackLUT::instance();
+    const __m256i shuf_dist = _mm256_setr_epi8(
+        0, 1, -1, -1, Stride, Stride + 1, -1, -1, 2 * Stride, 2 * Stride + 1, -1, -1, 3 * Stride, 3 * Stride + 1, -1, -1,
+        0, 1, -1, -1, Stride, Stride + 1, -1, -1, 2 * Stride, 2 * Stride + 1, -1, -1, 3 * Stride, 3 * Stride + 1, -1, -1);
+    const __m256i shuf_int  = _mm256_setr_epi8(
+        2, -1, -1, -1, Stride + 2, -1, -1, -1, 2 * Stride + 2, -1, -1, -1, 3 * Stride + 2, -1, -1, -1,
+        2, -1, -1, -1, Stride + 2, -1, -1, -1, 2 * Stride + 2, -1, -1, -1, 3 * Stride + 2, -1, -1, -1);
+    const __m256 vca = _mm256_set1_ps(cos_az);
+    const __m256 vsa = _mm256_set1_ps(sin_az);
+    const __m256 vunit = _mm256_set1_ps(dist_unit);
+    const __m256 vmin = _mm256_set1_ps(min_range);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    int n = 0;
+    uint32_t zeros = 0;
+    for (int ch = 0; ch < Lasers; ch += 8) {
+        const uint8_t* p = records + ch * Stride;
+        __m256i raw = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4 * Stride)), 1);
+        __m256i dist_i = _mm256_shuffle_epi8(raw, shuf_dist);
+        __m256 d = _mm256_mul_ps(_mm256_cvtepi32_ps(dist_i), vunit);
+        __m256 is_zero = _mm256_castsi256_ps(_mm256_cmpeq_epi32(dist_i, zero));
+        zeros += __builtin_popcount(static_cast<unsigned>(_mm256_movemask_ps(is_zero)));
+        __m256 valid = _mm256_andnot_ps(is_zero, _mm256_cmp_ps(d, vmin, _CMP_GE_OQ));
+        int mask = _mm256_movemask_ps(valid);
+        if (!mask) continue;
+
+        const __m256 kc = _mm256_load_ps(tables.xy_cos + ch);
+        const __m256 ks = _mm256_load_ps(tables.xy_sin + ch);
+        const __m256 se = _mm256_load_ps(tables.sin_elev + ch);
+        __m256 x = _mm256_mul_ps(d, _mm256_sub_ps(_mm256_mul_ps(vca, kc), _mm256_mul_ps(vsa, ks)));
+        __m256 y = _mm256_mul_ps(d, _mm256_add_ps(_mm256_mul_ps(vsa, kc), _mm256_mul_ps(vca, ks)));
+        __m256 z = _mm256_mul_ps(d, se);
+
+        const __m256i perm = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&lut.avx[mask])));
+        _mm256_storeu_ps(out.x + n, _mm256_permutevar8x32_ps(x, perm));
+        _mm256_storeu_ps(out.y + n, _mm256_permutevar8x32_ps(y, perm));
+        _mm256_storeu_ps(out.z + n, _mm256_permutevar8x32_ps(z, perm));
+
+        __m256i inten = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(raw, shuf_int), perm);
+        __m256i laser = _mm256_permutevar8x32_epi32(_mm256_add_epi32(lane_ids, _mm256_set1_epi32(ch)), perm);
+        __m128i inten16 = _mm_packus_epi32(_mm256_castsi256_si128(inten), _mm256_extracti128_si256(inten, 1));
+        __m128i laser16 = _mm_packus_epi32(_mm256_castsi256_si128(laser), _mm256_extracti128_si256(laser, 1));
+        // bytes 0..7 intensity, 8..15 laser id
+        __m128i packed = _mm_packus_epi16(inten16, laser16);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out.intensity + n), packed);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out.laser_id + n), _mm_unpackhi_epi64(packed, packed));
+
+        n += __builtin_popcount(static_cast<unsigned>(mask));
+    }
+    *out.zeros += zeros;
+    return n;
+}
+
+// Pandar64 instantiations under their original names
+__attribute__((target("sse4.1")))
+inline int decode_block_sse41(const uint8_t* records, int channels,
+                              float cos_az, float sin_az,
+                              float dist_unit, float min_range,
+                              const BlockTables& tables, const BlockOutput& out)
+{
+    return decode_block_sse41_t<PANDAR64_LASERS, PANDAR64_RECORD_BYTES>(records, channels, cos_az, sin_az,
+                                                                        dist_unit, min_range, tables, out);
+}
+
+__attribute__((target("avx2")))
+inline int decode_block_avx2(const uint8_t* records, int channels,
+                             float cos_az, float sin_az,
+                             float dist_unit, float min_range,
+                             const BlockTables& tables, const BlockOutput& out)
+{
+    return decode_block_avx2_t<PANDAR64_LASERS, PANDAR64_RECORD_BYTES>(records, channels, cos_az, sin_az,
+                                                                       dist_unit, min_range, tables, out);
+}
+
+#endif // PANDAR64_X86
+
+//==========================================================================
+// Runtime selection
+//==========================================================================
+inline SimdLevel detect_simd_level() {
+#ifdef PANDAR64_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return SIMD_SSE41;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Decoder for blocks of `Lasers` records of `Stride` bytes
+template <int Lasers, int Stride>
+inline BlockDecodeFn select_block_decoder_t(SimdLevel level) {
+#ifdef PANDAR64_X86
+    if (level == SIMD_AVX2) return decode_block_avx2_t<Lasers, Stride>;
+    if (level == SIMD_SSE41) return decode_block_sse41_t<Lasers, Stride>;
+#else
+    (void)level;
+#endif
+    return decode_block_scalar_t<Lasers, Stride>;
+}
+
+inline BlockDecodeFn select_block_decoder(SimdLevel level) {
+    return select_block_decoder_t<PANDAR64_LASERS, PANDAR64_RECORD_BYTES>(level);
+}
+
+#endif // PANDAR64_SIMD_H
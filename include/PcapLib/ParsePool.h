@@ -0,0 +1,200 @@
+#pragma once
+//==============================================
+// Multithreaded, order-preserving packet parsing
+// Packets are submitted in sequence into a ring of slots, N workers (each with
+// its own Pandar64Parser) claim and parse them in parallel, and the consumer
+// drains the results strictly in submission order.
+//==============================================
+#ifndef PARSE_POOL_H
+#define PARSE_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include "PCAP_parse.h"
+
+#define PARSE_POOL_SLOTS 256
+
+class ParsePool {
+private:
+    struct Slot {
+        PCAP_PacketView packet {};
+        std::vector<u_char> storage;           // packet copy when the source buffer is reused
+        PointCloudSoA points;
+        PacketTail tail;
+        std::atomic<bool> done {false};
+    };
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<std::thread> workers;
+    std::vector<Pandar64Parser> parsers;       // one per worker
+    std::shared_ptr<ParseStats> stats;         // shared by the workers: counters of the whole stream
+
+    alignas(64) std::atomic<uint64_t> submitted {0};   // written by the consumer
+    alignas(64) std::atomic<uint64_t> claimed {0};     // next sequence to parse
+    alignas(64) uint64_t delivered {0};                // consumer only
+
+    std::mutex mtx;
+    std::condition_variable cv_work;           // workers wait for packets
+    std::condition_variable cv_done;           // consumer waits for the next result
+    std::atomic<int> idle_workers {0};
+    std::atomic<bool> consumer_waiting {false};
+    std::atomic<bool> stopping {false};
+
+    inline Slot& slot(uint64_t seq) {
+        return *slots[seq % slots.size()];
+    }
+
+    void worker_loop(size_t id) {
+        Pandar64Parser& parser = parsers[id];
+        while (true) {
+            uint64_t seq = claimed.load(std::memory_order_relaxed);
+            if (seq < submitted.load(std::memory_order_acquire)) {
+                if (!claimed.compare_exchange_weak(seq, seq + 1, std::memory_order_acq_rel)) continue;
+
+                Slot& s = slot(seq);
+                s.points.clear();
+                parser.parse_packet(s.packet, s.points);
+                s.tail = parser.last_tail();
+                s.done.store(true);   // seq_cst: pairs with consumer_waiting (no lost wake-up)
+
+                if (consumer_waiting.load()) {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    cv_done.notify_one();
+                }
+                continue;
+            }
+
+            // no work: sleep until submit() or stop
+            std::unique_lock<std::mutex> lock(mtx);
+            idle_workers.fetch_add(1);
+            cv_work.wait(lock, [&] {
+                return stopping.load() || claimed.load() < submitted.load();
+            });
+            idle_workers.fetch_sub(1);
+            if (stopping.load() && claimed.load() >= submitted.load()) return;
+        }
+    }
+
+public:
+    /**
+     * @param threads So worker thread (>= 1).
+     * @param slot_count So packet toi da dang xu ly cung luc. Packet view phai con hop le
+     *                   den khi ket qua cua no duoc drain (mmap file: luon dung;
+     *                   UDP_receiver: slot_count phai nho hon so slot cua ring).
+     * @param calibration Goc laser dung chung cho moi worker (nullptr = bang mac dinh).
+     * @param options Model / echo cua stream (MODEL_AUTO: moi worker tu nhan dien).
+     */
+    explicit ParsePool(size_t threads, size_t slot_count = PARSE_POOL_SLOTS,
+                       std::shared_ptr<CalibrationStore> calibration = nullptr,
+                       const ParserOptions& options = ParserOptions()) {
+        if (threads == 0) threads = 1;
+        if (slot_count < threads) slot_count = threads;
+
+        slots.reserve(slot_count);
+        for (size_t k = 0; k < slot_count; k++) {
+            slots.emplace_back(new Slot());
+            slots.back()->points.reserve(LIDAR_MAX_PACKET_POINTS);
+        }
+        parsers.resize(threads);
+        stats = std::make_shared<ParseStats>();
+        for (auto& p : parsers) {
+            p.configure(options);
+            p.set_stats(stats);
+        }
+        if (calibration) {
+            for (auto& p : parsers) p.set_calibration(calibration);
+        }
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back(&ParsePool::worker_loop, this, t);
+        }
+    }
+
+    ParsePool(const ParsePool&) = delete;
+    ParsePool& operator=(const ParsePool&) = delete;
+
+    ~ParsePool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping.store(true);
+        }
+        cv_work.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    // Queue one packet. Returns false (without queueing) if every slot is in flight:
+    // drain() first. copy = true keeps a private copy of the packet bytes, for
+    // sources whose buffer is reused right away (PacketRing, libpcap live).
+    bool try_submit(const PCAP_PacketView& packet, bool copy = false) {
+        uint64_t seq = submitted.load(std::memory_order_relaxed);
+        if (seq - delivered >= slots.size()) return false;
+
+        Slot& s = slot(seq);
+        s.packet = packet;
+        if (copy) {
+            s.storage.assign(packet.packet_data, packet.packet_data + packet.packet_header.capture_length);
+            s.packet.packet_data = s.storage.data();
+        }
+        s.done.store(false, std::memory_order_relaxed);
+        submitted.store(seq + 1, std::memory_order_seq_cst);
+
+        if (idle_workers.load() > 0) {
+            std::lock_guard<std::mutex> lock(mtx);
+            cv_work.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Giao ket qua theo dung thu tu submit:
+     * fn(const PCAP_PacketView&, const PointCloudSoA&, const PacketTail&).
+     * block = true: cho it nhat 1 ket qua neu con packet dang xu ly.
+     * Tra ve so packet da giao.
+     */
+    template <typename Fn>
+    size_t drain(Fn&& fn, bool block = false) {
+        size_t count = 0;
+        while (delivered < submitted.load(std::memory_order_relaxed)) {
+            Slot& s = slot(delivered);
+            if (!s.done.load(std::memory_order_acquire)) {
+                if (!block || count > 0) break;
+
+                std::unique_lock<std::mutex> lock(mtx);
+                consumer_waiting.store(true);
+                cv_done.wait(lock, [&] { return s.done.load(); });
+                consumer_waiting.store(false);
+            }
+            fn(static_cast<const PCAP_PacketView&>(s.packet), static_cast<const PointCloudSoA&>(s.points),
+               static_cast<const PacketTail&>(s.tail));
+            delivered++;
+            count++;
+        }
+        return count;
+    }
+
+    // Drain everything still in flight
+    template <typename Fn>
+    size_t finish(Fn&& fn) {
+        size_t count = 0;
+        while (in_flight() > 0) count += drain(fn, true);
+        return count;
+    }
+
+    inline size_t in_flight() const {
+        return static_cast<size_t>(submitted.load(std::memory_order_relaxed) - delivered);
+    }
+
+    inline size_t thread_count() const {
+        return workers.size();
+    }
+
+    // Parse counters of all workers (packets still in flight not yet included)
+    inline const std::shared_ptr<ParseStats>& parse_stats() const {
+        return stats;
+    }
+};
+
+#endif // PARSE_POOL_H
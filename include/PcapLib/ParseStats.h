@@ -0,0 +1,157 @@
+#pragma once
+//==============================================
+// Parse / capture counters of one sensor stream
+// The hot path never writes to std::cerr: every rejected frame, packet or
+// record only bumps a counter. Parsers tally a packet locally and publish it
+// with one relaxed fetch_add per non-zero counter, so any thread can read the
+// totals (get / snapshot) while the parsers run. log_if_due() prints what
+// changed since its last report, at most once per interval.
+//==============================================
+#ifndef PARSE_STATS_H
+#define PARSE_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+#define PARSE_STATS_LOG_S 5.0   // default interval of log_if_due()
+
+enum ParseCounter {
+    PARSE_PACKETS = 0,          // packets handed to the parser
+    PARSE_EMPTY_PACKETS,        // packets that gave no point
+    PARSE_NON_UDP,              // not IPv4 / UDP, or frame too short for its headers
+    PARSE_VLAN,                 // 802.1Q tagged frames (accepted, counted only)
+    PARSE_LINEAR_FORMAT,        // no start-of-packet, decoded by the linear block scan (accepted)
+    PARSE_INVALID_SOP,          // no start-of-packet of the stream's model, nothing decoded either
+    PARSE_BAD_HEADER,           // start-of-packet present, laser / block count wrong
+    PARSE_TRUNCATED_BLOCKS,     // firings cut short by the end of the capture
+    PARSE_ZERO_DISTANCE,        // records without echo (distance 0)
+    PARSE_MIN_RANGE,            // records closer than MIN_RANGE_M
+    PARSE_COUNTER_COUNT
+};
+
+inline const char* parse_counter_name(ParseCounter c) {
+    static const char* const names[PARSE_COUNTER_COUNT] = {
+        "packets", "empty", "non-udp", "vlan", "linear-format", "invalid-sop", "bad-header",
+        "truncated-blocks", "zero-distance", "min-range"
+    };
+    return c < PARSE_COUNTER_COUNT ? names[c] : "?";
+}
+
+// Plain counter values: a parser's pending tally, or a copy of ParseStats
+struct ParseCounts {
+    uint64_t value[PARSE_COUNTER_COUNT] {};
+
+    inline uint64_t& operator[](ParseCounter c) { return value[c]; }
+    inline uint64_t operator[](ParseCounter c) const { return value[c]; }
+
+    inline void clear() {
+        for (auto& v : value) v = 0;
+    }
+
+    // every counter except packets / empty / vlan / linear-format: something was dropped
+    inline uint64_t rejected() const {
+        uint64_t n = 0;
+        for (int c = PARSE_NON_UDP; c < PARSE_COUNTER_COUNT; c++) {
+            if (c != PARSE_VLAN && c != PARSE_LINEAR_FORMAT) n += value[c];
+        }
+        return n;
+    }
+
+    ParseCounts operator-(const ParseCounts& other) const {
+        ParseCounts d;
+        for (int c = 0; c < PARSE_COUNTER_COUNT; c++) d.value[c] = value[c] - other.value[c];
+        return d;
+    }
+
+    // "packets=1200 empty=3 ..." (zero counters left out, packets always shown)
+    void print(FILE* out) const {
+        std::fprintf(out, "%s=%llu", parse_counter_name(PARSE_PACKETS),
+                     static_cast<unsigned long long>(value[PARSE_PACKETS]));
+        for (int c = PARSE_PACKETS + 1; c < PARSE_COUNTER_COUNT; c++) {
+            if (value[c] == 0) continue;
+            std::fprintf(out, " %s=%llu", parse_counter_name(static_cast<ParseCounter>(c)),
+                         static_cast<unsigned long long>(value[c]));
+        }
+    }
+};
+
+class ParseStats {
+private:
+    std::atomic<uint64_t> counters[PARSE_COUNTER_COUNT];
+
+    // log_if_due(): time of the next report (steady_clock ns) and the totals last printed
+    std::atomic<int64_t> next_log_ns {0};
+    std::mutex log_mtx;
+    ParseCounts logged;
+
+    static inline int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    ParseStats() {
+        for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    }
+
+    ParseStats(const ParseStats&) = delete;
+    ParseStats& operator=(const ParseStats&) = delete;
+
+    inline void add(ParseCounter c, uint64_t n = 1) {
+        counters[c].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Publish a parser's tally (zero counters cost nothing)
+    inline void add(const ParseCounts& counts) {
+        for (int c = 0; c < PARSE_COUNTER_COUNT; c++) {
+            if (counts.value[c]) counters[c].fetch_add(counts.value[c], std::memory_order_relaxed);
+        }
+    }
+
+    inline uint64_t get(ParseCounter c) const {
+        return counters[c].load(std::memory_order_relaxed);
+    }
+
+    // Counters are read one by one: consistent per counter, not across counters
+    ParseCounts snapshot() const {
+        ParseCounts s;
+        for (int c = 0; c < PARSE_COUNTER_COUNT; c++) s.value[c] = counters[c].load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // log_if_due() would report now
+    inline bool due() const {
+        return now_ns() >= next_log_ns.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * In nhung gi thay doi tu lan in truoc, toi da 1 lan moi interval_s giay:
+     * "[STAT] <label> parse: packets=... zero-distance=..." (chi dem moi, bo counter = 0).
+     * Goi tu vong xu ly moi packet cung duoc: chua den han chi ton 1 lan doc clock.
+     * Tra ve true neu da in.
+     */
+    bool log_if_due(const char* label, double interval_s = PARSE_STATS_LOG_S, FILE* out = stderr) {
+        const int64_t now = now_ns();
+        if (now < next_log_ns.load(std::memory_order_relaxed)) return false;
+        std::unique_lock<std::mutex> lock(log_mtx, std::try_to_lock);
+        if (!lock.owns_lock()) return false;   // another thread is reporting
+        const int64_t due_ns = next_log_ns.load(std::memory_order_relaxed);
+        if (now < due_ns) return false;
+        next_log_ns.store(now + static_cast<int64_t>(interval_s * 1e9), std::memory_order_relaxed);
+        if (due_ns == 0) return false;   // first call only starts the interval
+
+        const ParseCounts total = snapshot();
+        const ParseCounts delta = total - logged;
+        logged = total;
+        if (delta[PARSE_PACKETS] == 0 && delta.rejected() == 0) return false;
+        std::fprintf(out, "[STAT] %s parse: ", label);
+        delta.print(out);
+        std::fprintf(out, "\n");
+        return true;
+    }
+};
+
+#endif // PARSE_STATS_H
@@ -0,0 +1,246 @@
+#pragma once
+//==============================================
+// Time / revolution index sidecar for pcap and pcapng files (<capture>.idx)
+// Time entries hold (timestamp, record offset) of every INDEX_TIME_STRIDE-th
+// packet; frame entries hold the offset to start reading from so the frame
+// assembler sees the wrap that begins revolution k. Seeking is a binary
+// search plus at most one stride of record headers.
+//
+// Building: one sequential pass hops over record headers only (no parsing)
+// to collect the time entries, then the packets between time entries are
+// split into chunks and scanned for azimuth wraps on several threads.
+//==============================================
+#ifndef PCAP_INDEX_H
+#define PCAP_INDEX_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include "PCAP_mmap.h"
+#include "PCAP_parse.h"
+#include "FrameAssembler.h"
+
+#define INDEX_MAGIC        "LVIDX01"   // 8 bytes with the terminating 0
+#define INDEX_TIME_STRIDE  64          // packets per time entry
+
+struct IndexEntry {
+    double stamp;                       // capture time (s)
+    uint64_t offset;                    // record / block offset in the capture
+};
+
+class PcapIndex {
+private:
+    struct FileHeader {
+        char magic[8];
+        uint64_t capture_size;          // size of the indexed capture, detects stale sidecars
+        uint64_t packet_count;
+        uint32_t stride;
+        uint32_t cut_cdeg;              // cut angle the frames were built with (0.01 deg)
+        uint64_t time_count;
+        uint64_t frame_count;
+    };
+
+    std::vector<IndexEntry> times;
+    std::vector<IndexEntry> frames;
+    uint64_t capture_size {0};
+    uint64_t packet_count {0};
+    uint32_t stride {INDEX_TIME_STRIDE};
+    uint32_t cut_cdeg {0};
+
+    static inline uint32_t cut_to_cdeg(float cut_angle) {
+        float a = std::fmod(cut_angle, 360.0f);
+        if (a < 0) a += 360.0f;
+        return static_cast<uint32_t>(std::lround(a * 100.0f) % FULL_TURN_CDEG);
+    }
+
+    static inline double stamp_of(const PCAP_PacketView& view) {
+        return view.packet_header.timestamp_second + view.packet_header.timestamp_microsecond * 1e-6;
+    }
+
+    // Revolution starts among the packets of time entries [first, last).
+    // Reading starts one entry earlier so the wrap detector is primed.
+    // False if the chunk could not be read (its frames would be missing).
+    bool scan_frames(const std::string& file, size_t first, size_t last, float cut_angle,
+                     std::vector<IndexEntry>& out) const {
+        if (first >= last) return true;
+        PCAP_mmap reader;
+        if (!reader.open_file(file)) return false;
+
+        const uint64_t begin = times[first].offset;
+        const uint64_t end = last < times.size() ? times[last].offset : capture_size;
+        if (!reader.seek(first > 0 ? times[first - 1].offset : times[0].offset)) return false;
+
+        Pandar64Parser parser;
+        AzimuthWrapDetector wrap(cut_angle);
+        PCAP_PacketView view;
+        uint16_t az[LIDAR_MAX_BLOCKS];
+        uint64_t prev_offset = reader.offset();
+
+        while (true) {
+            uint64_t offset = reader.offset();
+            if (offset >= end || !reader.read_packet(view)) break;
+
+            size_t blocks = parser.block_azimuths(view, az, LIDAR_MAX_BLOCKS);
+            for (size_t b = 0; b < blocks; b++) {
+                if (!wrap.update(az[b])) continue;
+                // wrap at the first block: start at the previous packet so the
+                // assembler still sees the backward jump
+                if (offset >= begin) out.push_back({ stamp_of(view), b == 0 ? prev_offset : offset });
+            }
+            prev_offset = offset;
+        }
+        return true;
+    }
+
+public:
+    static std::string sidecar_path(const std::string& capture) {
+        return capture + ".idx";
+    }
+
+    /**
+     * Quet file capture va tao index.
+     * @param threads So thread quet wrap azimuth (>= 1).
+     * @param cut_angle Goc cat frame (do), phai giong FrameAssembler khi doc.
+     */
+    bool build(const std::string& file, size_t threads, float cut_angle = 0.0f,
+               uint32_t time_stride = INDEX_TIME_STRIDE) {
+        times.clear();
+        frames.clear();
+        stride = std::max<uint32_t>(time_stride, 1);
+        cut_cdeg = cut_to_cdeg(cut_angle);
+
+        // pass 1: record headers only
+        PCAP_mmap reader;
+        if (!reader.open_file(file)) return false;
+        capture_size = reader.size();
+        packet_count = 0;
+        PCAP_PacketView view;
+        while (true) {
+            uint64_t offset = reader.offset();
+            if (!reader.read_packet(view)) break;
+            if (packet_count % stride == 0) times.push_back({ stamp_of(view), offset });
+            packet_count++;
+        }
+        reader.close_file();
+        if (times.empty()) {
+            std::cerr << "Index: no packets in " << file << std::endl;
+            return false;
+        }
+
+        // pass 2: azimuth wraps, chunks of time entries in parallel
+        threads = std::max<size_t>(1, std::min(threads, times.size()));
+        std::vector<std::vector<IndexEntry>> found(threads);
+        std::vector<char> scanned(threads, 0);
+        std::vector<std::thread> workers;
+        const size_t per = (times.size() + threads - 1) / threads;
+        for (size_t t = 0; t < threads; t++) {
+            size_t first = t * per;
+            size_t last = std::min(times.size(), first + per);
+            workers.emplace_back([this, &file, first, last, cut_angle, &found, &scanned, t] {
+                scanned[t] = scan_frames(file, first, last, cut_angle, found[t]);
+            });
+        }
+        for (auto& w : workers) w.join();
+        for (size_t t = 0; t < threads; t++) {
+            if (scanned[t]) continue;
+            std::cerr << "Index: cannot scan frames of " << file << " from offset "
+                      << times[t * per].offset << std::endl;
+            frames.clear();
+            return false;
+        }
+        for (auto& f : found) frames.insert(frames.end(), f.begin(), f.end());
+        return true;
+    }
+
+    bool save(const std::string& path) const {
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) {
+            std::cerr << "Index: cannot write " << path << std::endl;
+            return false;
+        }
+        FileHeader h {};
+        std::memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+        h.capture_size = capture_size;
+        h.packet_count = packet_count;
+        h.stride = stride;
+        h.cut_cdeg = cut_cdeg;
+        h.time_count = times.size();
+        h.frame_count = frames.size();
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+                  std::fwrite(times.data(), sizeof(IndexEntry), times.size(), f) == times.size() &&
+                  std::fwrite(frames.data(), sizeof(IndexEntry), frames.size(), f) == frames.size();
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok) std::cerr << "Index: write failed " << path << std::endl;
+        return ok;
+    }
+
+    /**
+     * Doc sidecar. Tra ve false neu khong co, hong, hoac khong khop voi capture
+     * (kich thuoc file / goc cat khac) -> can build lai.
+     */
+    bool load(const std::string& path, uint64_t expected_capture_size, float cut_angle = 0.0f) {
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+        FileHeader h {};
+        bool ok = std::fread(&h, sizeof(h), 1, f) == 1 &&
+                  std::memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) == 0 &&
+                  h.capture_size == expected_capture_size &&
+                  h.cut_cdeg == cut_to_cdeg(cut_angle) &&
+                  h.time_count > 0 && h.time_count <= h.packet_count &&
+                  h.frame_count <= h.packet_count * 6;
+        if (ok) {
+            times.resize(h.time_count);
+            frames.resize(h.frame_count);
+            ok = std::fread(times.data(), sizeof(IndexEntry), times.size(), f) == times.size() &&
+                 std::fread(frames.data(), sizeof(IndexEntry), frames.size(), f) == frames.size();
+        }
+        std::fclose(f);
+        if (!ok) {
+            times.clear();
+            frames.clear();
+            return false;
+        }
+        capture_size = h.capture_size;
+        packet_count = h.packet_count;
+        stride = h.stride;
+        cut_cdeg = h.cut_cdeg;
+        return true;
+    }
+
+    /**
+     * Dat reader tai packet dau tien co timestamp >= t (giay, tuyet doi).
+     * Binary search tren time entry, roi doc toi da 1 stride header.
+     */
+    bool seek_time(PCAP_mmap& reader, double t) const {
+        if (times.empty()) return false;
+        auto it = std::upper_bound(times.begin(), times.end(), t,
+                                   [](double v, const IndexEntry& e) { return v < e.stamp; });
+        if (it != times.begin()) --it;
+        if (!reader.seek(it->offset)) return false;
+
+        PCAP_PacketView view;
+        while (true) {
+            uint64_t offset = reader.offset();
+            if (!reader.read_packet(view)) return false;
+            if (stamp_of(view) >= t) return reader.seek(offset);
+        }
+    }
+
+    // Dat reader de frame tiep theo FrameAssembler xuat ra la vong quay thu `frame`
+    bool seek_frame(PCAP_mmap& reader, size_t frame) const {
+        if (frame >= frames.size()) return false;
+        return reader.seek(frames[frame].offset);
+    }
+
+    inline size_t frame_count() const { return frames.size(); }
+    inline uint64_t packets() const { return packet_count; }
+    inline size_t time_entries() const { return times.size(); }
+    inline double start_time() const { return times.empty() ? 0.0 : times.front().stamp; }
+    inline const IndexEntry& frame_entry(size_t k) const { return frames[k]; }
+};
+
+#endif // PCAP_INDEX_H
@@ -0,0 +1,191 @@
+#pragma once
+//==============================================
+// Structure-of-arrays point cloud
+// Every attribute lives in its own 64-byte aligned column, so a stage only
+// touches the columns it needs (the 2D viewer reads x and y only) and the
+// loops over them vectorize. clear() keeps the capacity for reuse.
+//==============================================
+#ifndef POINT_CLOUD_SOA_H
+#define POINT_CLOUD_SOA_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+
+#define SOA_ALIGNMENT 64
+#define SOA_PADDING   16    // spare elements allocated past capacity()
+
+// return_index values: which echo of the laser firing a point is
+#define POINT_RETURN_STRONGEST 0
+#define POINT_RETURN_LAST      1
+#define POINT_RETURN_FIRST     2
+
+// Number of column (re)allocations made by all clouds since start.
+// Stays flat in steady state when buffers are reused.
+inline std::atomic<uint64_t>& soa_allocation_counter() {
+    static std::atomic<uint64_t> counter {0};
+    return counter;
+}
+
+//================ COLUMN =======================
+template <typename T>
+class AlignedColumn {
+private:
+    T* ptr {nullptr};
+    size_t cap {0};
+
+public:
+    AlignedColumn() = default;
+    AlignedColumn(const AlignedColumn&) = delete;
+    AlignedColumn& operator=(const AlignedColumn&) = delete;
+
+    AlignedColumn(AlignedColumn&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), cap(std::exchange(other.cap, 0)) {}
+
+    AlignedColumn& operator=(AlignedColumn&& other) noexcept {
+        if (this != &other) {
+            std::free(ptr);
+            ptr = std::exchange(other.ptr, nullptr);
+            cap = std::exchange(other.cap, 0);
+        }
+        return *this;
+    }
+
+    ~AlignedColumn() {
+        std::free(ptr);
+    }
+
+    // grow to at least n elements, keeping the first `keep` ones
+    void reserve(size_t n, size_t keep) {
+        if (n <= cap) return;
+        size_t bytes = (n + SOA_PADDING) * sizeof(T);
+        bytes = (bytes + SOA_ALIGNMENT - 1) / SOA_ALIGNMENT * SOA_ALIGNMENT;
+        T* fresh = static_cast<T*>(std::aligned_alloc(SOA_ALIGNMENT, bytes));
+        if (!fresh) throw std::bad_alloc();
+        soa_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+        if (ptr && keep) std::memcpy(fresh, ptr, keep * sizeof(T));
+        std::free(ptr);
+        ptr = fresh;
+        cap = n;
+    }
+
+    inline T* data() { return ptr; }
+    inline const T* data() const { return ptr; }
+    inline T& operator[](size_t i) { return ptr[i]; }
+    inline const T& operator[](size_t i) const { return ptr[i]; }
+    inline size_t capacity() const { return cap; }
+};
+
+//================ CLOUD ========================
+class PointCloudSoA {
+public:
+    AlignedColumn<float>    x;
+    AlignedColumn<float>    y;
+    AlignedColumn<float>    z;
+    AlignedColumn<uint8_t>  intensity;
+    AlignedColumn<uint8_t>  laser_id;
+    AlignedColumn<uint16_t> azimuth;     // block azimuth, 0.01 deg units
+    AlignedColumn<double>   timestamp;   // seconds
+    AlignedColumn<uint8_t>  return_index;   // POINT_RETURN_STRONGEST / LAST / FIRST
+
+    PointCloudSoA() = default;
+
+    PointCloudSoA(PointCloudSoA&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    PointCloudSoA& operator=(PointCloudSoA&& other) noexcept {
+        if (this != &other) {
+            x = std::move(other.x);
+            y = std::move(other.y);
+            z = std::move(other.z);
+            intensity = std::move(other.intensity);
+            laser_id = std::move(other.laser_id);
+            azimuth = std::move(other.azimuth);
+            timestamp = std::move(other.timestamp);
+            return_index = std::move(other.return_index);
+            count = std::exchange(other.count, 0);
+            cap = std::exchange(other.cap, 0);
+        }
+        return *this;
+    }
+
+    explicit PointCloudSoA(size_t n) {
+        reserve(n);
+    }
+
+    void reserve(size_t n) {
+        if (n <= cap) return;
+        x.reserve(n, count);
+        y.reserve(n, count);
+        z.reserve(n, count);
+        intensity.reserve(n, count);
+        laser_id.reserve(n, count);
+        azimuth.reserve(n, count);
+        timestamp.reserve(n, count);
+        return_index.reserve(n, count);
+        cap = n;
+    }
+
+    // make room for `extra` more points, growing geometrically
+    inline void reserve_extra(size_t extra) {
+        if (count + extra > cap) reserve(std::max(count + extra, cap * 2));
+    }
+
+    // resize without initialising the new points (columns are filled by the caller)
+    inline void resize(size_t n) {
+        reserve(n);
+        count = n;
+    }
+
+    inline void push_back(float px, float py, float pz, uint8_t inten,
+                          uint8_t laser, uint16_t az, double ts, uint8_t ret = POINT_RETURN_STRONGEST) {
+        reserve_extra(1);
+        x[count] = px;
+        y[count] = py;
+        z[count] = pz;
+        intensity[count] = inten;
+        laser_id[count] = laser;
+        azimuth[count] = az;
+        timestamp[count] = ts;
+        return_index[count] = ret;
+        count++;
+    }
+
+    // append points [first, first + n) of another cloud
+    void append_range(const PointCloudSoA& other, size_t first, size_t n) {
+        if (n == 0) return;
+        reserve_extra(n);
+        std::memcpy(x.data() + count, other.x.data() + first, n * sizeof(float));
+        std::memcpy(y.data() + count, other.y.data() + first, n * sizeof(float));
+        std::memcpy(z.data() + count, other.z.data() + first, n * sizeof(float));
+        std::memcpy(intensity.data() + count, other.intensity.data() + first, n);
+        std::memcpy(laser_id.data() + count, other.laser_id.data() + first, n);
+        std::memcpy(azimuth.data() + count, other.azimuth.data() + first, n * sizeof(uint16_t));
+        std::memcpy(timestamp.data() + count, other.timestamp.data() + first, n * sizeof(double));
+        std::memcpy(return_index.data() + count, other.return_index.data() + first, n);
+        count += n;
+    }
+
+    // append all points of another cloud
+    inline void append(const PointCloudSoA& other) {
+        append_range(other, 0, other.count);
+    }
+
+    // drop points, keep memory
+    inline void clear() { count = 0; }
+
+    inline size_t size() const { return count; }
+    inline size_t capacity() const { return cap; }
+    inline bool empty() const { return count == 0; }
+
+private:
+    size_t count {0};
+    size_t cap {0};
+};
+
+#endif // POINT_CLOUD_SOA_H
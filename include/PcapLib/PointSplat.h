@@ -0,0 +1,214 @@
+#pragma once
+//==============================================
+// Point splatting straight into a CV_8UC3 canvas
+// Replaces one cv::circle(FILLED) per point. Screen coordinates are rounded
+// to pixels and turned into byte offsets in a SIMD pass (points whose whole
+// disc lies inside the canvas), then every point is written as a precomputed
+// disc stamp of byte offsets. Points near the border take a bounds-checked
+// scalar path. Pixel rounding matches cvRound (round half to even).
+//==============================================
+#ifndef POINT_SPLAT_H
+#define POINT_SPLAT_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include "Pandar64_simd.h"
+#include "Viewport.h"
+
+#define SPLAT_CHUNK      512        // points per offset pass (offsets stay in L1)
+#define SPLAT_OUTSIDE    (-1)       // offset of a point that needs the checked path
+
+// Pixel bounds where a point's whole disc fits, and the canvas row stride
+struct SplatBounds {
+    int32_t x_lo, x_hi;             // inclusive
+    int32_t y_lo, y_hi;
+    int32_t step;                   // bytes per row
+};
+
+typedef void (*SplatOffsetFn)(const float* px, const float* py, size_t n,
+                              const SplatBounds& b, int32_t* offsets);
+
+//==========================================================================
+// Offset pass: byte offset of the point's centre pixel, SPLAT_OUTSIDE if the
+// disc is not entirely inside the canvas
+//==========================================================================
+inline void splat_offsets_scalar(const float* px, const float* py, size_t n,
+                                 const SplatBounds& b, int32_t* offsets)
+{
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = pixel_round(px[i]);
+        int32_t y = pixel_round(py[i]);
+        bool inside = x >= b.x_lo && x <= b.x_hi && y >= b.y_lo && y <= b.y_hi;
+        offsets[i] = inside ? y * b.step + x * 3 : SPLAT_OUTSIDE;
+    }
+}
+
+#ifdef PANDAR64_X86
+
+__attribute__((target("sse4.1")))
+inline void splat_offsets_sse41(const float* px, const float* py, size_t n,
+                                const SplatBounds& b, int32_t* offsets)
+{
+    const __m128i x_lo = _mm_set1_epi32(b.x_lo - 1);
+    const __m128i x_hi = _mm_set1_epi32(b.x_hi + 1);
+    const __m128i y_lo = _mm_set1_epi32(b.y_lo - 1);
+    const __m128i y_hi = _mm_set1_epi32(b.y_hi + 1);
+    const __m128i step = _mm_set1_epi32(b.step);
+    const __m128i outside = _mm_set1_epi32(SPLAT_OUTSIDE);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_cvtps_epi32(_mm_loadu_ps(px + i));
+        __m128i y = _mm_cvtps_epi32(_mm_loadu_ps(py + i));
+        __m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(x, x_lo), _mm_cmpgt_epi32(x_hi, x)),
+                                       _mm_and_si128(_mm_cmpgt_epi32(y, y_lo), _mm_cmpgt_epi32(y_hi, y)));
+        __m128i off = _mm_add_epi32(_mm_mullo_epi32(y, step), _mm_add_epi32(x, _mm_add_epi32(x, x)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(offsets + i), _mm_blendv_epi8(outside, off, inside));
+    }
+    splat_offsets_scalar(px + i, py + i, n - i, b, offsets + i);
+}
+
+__attribute__((target("avx2")))
+inline void splat_offsets_avx2(const float* px, const float* py, size_t n,
+                               const SplatBounds& b, int32_t* offsets)
+{
+    const __m256i x_lo = _mm256_set1_epi32(b.x_lo - 1);
+    const __m256i x_hi = _mm256_set1_epi32(b.x_hi + 1);
+    const __m256i y_lo = _mm256_set1_epi32(b.y_lo - 1);
+    const __m256i y_hi = _mm256_set1_epi32(b.y_hi + 1);
+    const __m256i step = _mm256_set1_epi32(b.step);
+    const __m256i outside = _mm256_set1_epi32(SPLAT_OUTSIDE);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_cvtps_epi32(_mm256_loadu_ps(px + i));
+        __m256i y = _mm256_cvtps_epi32(_mm256_loadu_ps(py + i));
+        __m256i inside = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(x, x_lo), _mm256_cmpgt_epi32(x_hi, x)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(y, y_lo), _mm256_cmpgt_epi32(y_hi, y)));
+        __m256i off = _mm256_add_epi32(_mm256_mullo_epi32(y, step),
+                                       _mm256_add_epi32(x, _mm256_add_epi32(x, x)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(offsets + i), _mm256_blendv_epi8(outside, off, inside));
+    }
+    splat_offsets_scalar(px + i, py + i, n - i, b, offsets + i);
+}
+
+#endif // PANDAR64_X86
+
+inline SplatOffsetFn select_splat_offsets(SimdLevel level) {
+#ifdef PANDAR64_X86
+    if (level == SIMD_AVX2) return splat_offsets_avx2;
+    if (level == SIMD_SSE41) return splat_offsets_sse41;
+#else
+    (void)level;
+#endif
+    return splat_offsets_scalar;
+}
+
+//==========================================================================
+// Splatter: owns the disc stamp for the current radius / canvas stride
+//==========================================================================
+class PointSplatter {
+private:
+    SimdLevel simd_level;
+    SplatOffsetFn offsets_fn;
+    int stamp_radius {-1};
+    int32_t stamp_step {0};
+    std::vector<int32_t> stamp;         // byte offsets of the disc pixels from the centre
+    std::vector<int8_t> stamp_dx;       // same pixels as (dx, dy), for the checked path
+    std::vector<int8_t> stamp_dy;
+    int32_t offsets[SPLAT_CHUNK];
+
+    // disc = pixels with dx^2 + dy^2 <= r^2 (r = 0: 1 pixel, r = 1: plus shape)
+    void build_stamp(int radius, int32_t step) {
+        stamp.clear();
+        stamp_dx.clear();
+        stamp_dy.clear();
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                if (dx * dx + dy * dy > radius * radius) continue;
+                stamp.push_back(dy * step + dx * 3);
+                stamp_dx.push_back(static_cast<int8_t>(dx));
+                stamp_dy.push_back(static_cast<int8_t>(dy));
+            }
+        }
+        stamp_radius = radius;
+        stamp_step = step;
+    }
+
+    static inline void put(uint8_t* p, uint8_t b, uint8_t g, uint8_t r) {
+        p[0] = b;
+        p[1] = g;
+        p[2] = r;
+    }
+
+public:
+    explicit PointSplatter(SimdLevel level = detect_simd_level()) {
+        set_simd_level(level);
+    }
+
+    void set_simd_level(SimdLevel level) {
+        simd_level = level;
+        offsets_fn = select_splat_offsets(level);
+    }
+
+    inline SimdLevel get_simd_level() const {
+        return simd_level;
+    }
+
+    /**
+     * Ve n diem (toa do pixel dang float) len canvas CV_8UC3.
+     * @param radius Ban kinh dia (0 = 1 pixel), toi da 127.
+     */
+    void splat(cv::Mat& canvas, const float* px, const float* py, size_t n,
+               const cv::Scalar& color, int radius)
+    {
+        if (n == 0 || canvas.empty()) return;
+        radius = std::max(0, std::min(radius, 127));
+        const int32_t step = static_cast<int32_t>(canvas.step);
+        if (radius != stamp_radius || step != stamp_step) build_stamp(radius, step);
+
+        const uint8_t cb = cv::saturate_cast<uint8_t>(color[0]);
+        const uint8_t cg = cv::saturate_cast<uint8_t>(color[1]);
+        const uint8_t cr = cv::saturate_cast<uint8_t>(color[2]);
+        const int32_t cols = canvas.cols;
+        const int32_t rows = canvas.rows;
+        const SplatBounds bounds = { radius, cols - 1 - radius, radius, rows - 1 - radius, step };
+        uint8_t* data = canvas.data;
+        const int32_t* st = stamp.data();
+        const size_t stamp_size = stamp.size();
+
+        for (size_t base = 0; base < n; base += SPLAT_CHUNK) {
+            const size_t m = std::min<size_t>(SPLAT_CHUNK, n - base);
+            offsets_fn(px + base, py + base, m, bounds, offsets);
+
+            for (size_t i = 0; i < m; i++) {
+                const int32_t off = offsets[i];
+                if (off != SPLAT_OUTSIDE) {
+                    uint8_t* centre = data + off;
+                    if (radius == 0) {
+                        put(centre, cb, cg, cr);
+                    } else {
+                        for (size_t k = 0; k < stamp_size; k++) put(centre + st[k], cb, cg, cr);
+                    }
+                    continue;
+                }
+
+                // border or off-canvas: check every pixel of the disc
+                int32_t x = pixel_round(px[base + i]);
+                int32_t y = pixel_round(py[base + i]);
+                if (x < -radius || x >= cols + radius || y < -radius || y >= rows + radius) continue;
+                for (size_t k = 0; k < stamp_size; k++) {
+                    int32_t sx = x + stamp_dx[k];
+                    int32_t sy = y + stamp_dy[k];
+                    if (sx < 0 || sx >= cols || sy < 0 || sy >= rows) continue;
+                    put(data + sy * step + sx * 3, cb, cg, cr);
+                }
+            }
+        }
+    }
+};
+
+#endif // POINT_SPLAT_H
@@ -0,0 +1,133 @@
+#pragma once
+//==============================================
+// Capture-timestamp pacing for offline replay
+// Packet k is delivered at wall_start + (stamp_k - stamp_0) / speed. Waits
+// sleep until REPLAY_SPIN_US before the deadline and busy-wait the rest,
+// which keeps delivery jitter in the microseconds without burning a core on
+// long gaps. Lateness (delivery time - due time) is recorded per packet.
+//==============================================
+#ifndef REPLAY_CLOCK_H
+#define REPLAY_CLOCK_H
+
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include "PCAP_capture.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REPLAY_CPU_RELAX() _mm_pause()
+#else
+#define REPLAY_CPU_RELAX() ((void)0)
+#endif
+
+#define REPLAY_SPIN_US     200      // busy-wait this close to the deadline
+#define REPLAY_MAX_GAP_S   2.0      // longer capture gaps are skipped (clock rebased)
+#define REPLAY_MIN_SPEED   0.1
+#define REPLAY_MAX_SPEED   10.0
+#define REPLAY_LATE_US     1000     // deliveries later than this are counted as late
+
+class ReplayClock {
+private:
+    typedef std::chrono::steady_clock clock;
+
+    double speed;                       // 0 = unpaced
+    bool started {false};
+    double base_stamp {0.0};            // capture time at base_wall
+    double last_stamp {0.0};
+    clock::time_point base_wall;
+
+    uint64_t delivered {0};
+    uint64_t late {0};
+    uint64_t rebased {0};
+    double late_sum {0.0};
+    double late_max {0.0};
+
+    void rebase(double stamp, clock::time_point now) {
+        base_stamp = stamp;
+        base_wall = now;
+    }
+
+public:
+    /**
+     * @param speed He so toc do (1 = thoi gian thuc), gioi han 0.1..10; 0 = khong dieu toc.
+     */
+    explicit ReplayClock(double speed = 1.0) : speed(0.0) {
+        set_speed(speed);
+    }
+
+    // Change speed; packets already delivered keep their timing
+    void set_speed(double s) {
+        speed = s <= 0.0 ? 0.0 : std::min(std::max(s, REPLAY_MIN_SPEED), REPLAY_MAX_SPEED);
+        if (started) rebase(last_stamp, clock::now());
+    }
+
+    inline double get_speed() const {
+        return speed;
+    }
+
+    inline bool paced() const {
+        return speed > 0.0;
+    }
+
+    void reset() {
+        started = false;
+        last_stamp = 0.0;
+        delivered = late = rebased = 0;
+        late_sum = late_max = 0.0;
+    }
+
+    /**
+     * Cho den luc packet co thoi diem capture `stamp` (giay) den han.
+     * Tra ve do tre so voi thoi diem goc (giay, >= 0).
+     */
+    double wait_until(double stamp) {
+        if (!paced()) return 0.0;
+
+        clock::time_point now = clock::now();
+        if (!started) {
+            started = true;
+            rebase(stamp, now);
+        } else if (stamp - last_stamp > REPLAY_MAX_GAP_S) {
+            // capture paused / file concatenated: do not sleep through the gap
+            rebase(stamp, now);
+            rebased++;
+        }
+        // timestamps going backwards are due together with the previous packet
+        last_stamp = std::max(last_stamp, stamp);
+
+        const clock::time_point due = base_wall + std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>((last_stamp - base_stamp) / speed));
+        const clock::duration spin = std::chrono::microseconds(REPLAY_SPIN_US);
+
+        if (due - now > spin) {
+            std::this_thread::sleep_for(due - now - spin);
+        }
+        while ((now = clock::now()) < due) {
+            REPLAY_CPU_RELAX();
+        }
+
+        double lateness = std::chrono::duration<double>(now - due).count();
+        delivered++;
+        late_sum += lateness;
+        late_max = std::max(late_max, lateness);
+        if (lateness > REPLAY_LATE_US * 1e-6) late++;
+        return lateness;
+    }
+
+    inline double wait(const PCAP_Header& header) {
+        return wait_until(header.timestamp_second + header.timestamp_microsecond * 1e-6);
+    }
+
+    //==========================================================================
+    // Statistics
+    //==========================================================================
+    inline uint64_t packets() const { return delivered; }
+    inline uint64_t late_packets() const { return late; }
+    inline uint64_t gaps_skipped() const { return rebased; }
+    inline double mean_lateness() const { return delivered ? late_sum / delivered : 0.0; }
+    inline double max_lateness() const { return late_max; }
+};
+
+#endif // REPLAY_CLOCK_H
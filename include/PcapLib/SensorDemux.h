@@ -0,0 +1,516 @@
+#pragma once
+//==============================================
+// Multi-sensor demultiplexer
+// Packets are routed on their IPv4 source address and UDP source port to one
+// sensor each. Every sensor owns a packet ring, a parser (own calibration), a
+// frame assembler and a worker thread; its points are moved into the common
+// frame by the sensor's extrinsics. Completed revolutions are queued per
+// sensor and merged once every sensor has a revolution whose middle lies
+// within SENSOR_ALIGN_S of the others, so a merged frame is one sweep of
+// every unit at about the same time. A sensor whose last revolution is more
+// than SENSOR_SILENCE_S (capture clock) behind the newest one is left out
+// until it sends again, instead of holding back the others.
+//==============================================
+#ifndef SENSOR_DEMUX_H
+#define SENSOR_DEMUX_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "PCAP_capture.h"
+#include "PCAP_parse.h"
+#include "PacketRing.h"
+#include "FrameAssembler.h"
+
+#define SENSOR_MAX           8         // sensors routed by one demux
+#define SENSOR_QUEUE_FRAMES  4         // revolutions waiting for the other sensors
+#define SENSOR_ALIGN_S       0.05      // half a revolution at 10 Hz
+#define SENSOR_SILENCE_S     0.5       // no revolution for this long: sensor absent from the merge
+#define SENSOR_FRAME_POINTS  (600 * 384)
+
+// IPv4 source address (host order) and UDP source port; port 0 matches any port
+struct SensorKey {
+    uint32_t ip {0};
+    uint16_t port {0};
+
+    inline bool matches(const SensorKey& source) const {
+        return ip == source.ip && (port == 0 || port == source.port);
+    }
+
+    std::string to_string() const {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%u.%u.%u.%u:%u", ip >> 24, (ip >> 16) & 0xFF,
+                      (ip >> 8) & 0xFF, ip & 0xFF, port);
+        return buf;
+    }
+};
+
+// Source address of an Ethernet(/VLAN)/IPv4/UDP frame. Returns false for anything else.
+inline bool packet_source(const u_char* data, size_t caplen, SensorKey& key) {
+    if (!data || caplen < 42) return false;
+    size_t ip_offset = 14;
+    uint16_t ethertype = (data[12] << 8) | data[13];
+    if (ethertype == 0x8100) {  // VLAN
+        ethertype = (data[16] << 8) | data[17];
+        ip_offset += 4;
+    }
+    if (ethertype != 0x0800 || caplen < ip_offset + 20) return false;
+
+    const u_char* ip = data + ip_offset;
+    size_t udp_offset = ip_offset + (ip[0] & 0x0F) * 4;
+    if (ip[9] != 17 || caplen < udp_offset + 8) return false;
+
+    key.ip = (uint32_t(ip[12]) << 24) | (uint32_t(ip[13]) << 16) | (uint32_t(ip[14]) << 8) | ip[15];
+    key.port = static_cast<uint16_t>((data[udp_offset] << 8) | data[udp_offset + 1]);
+    return true;
+}
+
+// Rigid transform sensor -> common frame: p' = R p + t
+struct Extrinsics {
+    float r[9] {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    float t[3] {0, 0, 0};
+    bool identity {true};
+
+    /**
+     * @param x,y,z Vi tri sensor (m).
+     * @param roll,pitch,yaw Goc (do), R = Rz(yaw) * Ry(pitch) * Rx(roll).
+     */
+    static Extrinsics from_pose(float x, float y, float z, float roll, float pitch, float yaw) {
+        const double d = M_PI / 180.0;
+        const double cr = std::cos(roll * d), sr = std::sin(roll * d);
+        const double cp = std::cos(pitch * d), sp = std::sin(pitch * d);
+        const double cy = std::cos(yaw * d), sy = std::sin(yaw * d);
+        Extrinsics e;
+        const double m[9] = {
+            cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr,
+            sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr,
+            -sp,     cp * sr,                cp * cr
+        };
+        for (int k = 0; k < 9; k++) e.r[k] = static_cast<float>(m[k]);
+        e.t[0] = x;
+        e.t[1] = y;
+        e.t[2] = z;
+        e.identity = x == 0 && y == 0 && z == 0 && roll == 0 && pitch == 0 && yaw == 0;
+        return e;
+    }
+
+    // Transform points [first, size) of the cloud in place
+    void apply(PointCloudSoA& cloud, size_t first) const {
+        if (identity) return;
+        const size_t n = cloud.size();
+        float* px = cloud.x.data();
+        float* py = cloud.y.data();
+        float* pz = cloud.z.data();
+        for (size_t i = first; i < n; i++) {
+            const float x = px[i], y = py[i], z = pz[i];
+            px[i] = r[0] * x + r[1] * y + r[2] * z + t[0];
+            py[i] = r[3] * x + r[4] * y + r[5] * z + t[1];
+            pz[i] = r[6] * x + r[7] * y + r[8] * z + t[2];
+        }
+    }
+};
+
+struct SensorConfig {
+    SensorKey key;
+    Extrinsics extrinsics;
+    std::string calibration_file;       // empty: the demux default calibration
+
+    /**
+     * Doc cau hinh dang "ip[:port][@x,y,z,roll,pitch,yaw]" (m, do).
+     */
+    static bool parse(const std::string& spec, SensorConfig& out) {
+        out = SensorConfig();
+        unsigned a, b, c, d, port = 0;
+        float p[6] = {0, 0, 0, 0, 0, 0};
+        const std::string addr = spec.substr(0, spec.find('@'));
+        int n = std::sscanf(addr.c_str(), "%u.%u.%u.%u:%u", &a, &b, &c, &d, &port);
+        if (n < 4 || a > 255 || b > 255 || c > 255 || d > 255 || port > 65535) {
+            std::cerr << "Invalid sensor address: " << spec << std::endl;
+            return false;
+        }
+        out.key.ip = (a << 24) | (b << 16) | (c << 8) | d;
+        out.key.port = static_cast<uint16_t>(port);
+        size_t at = spec.find('@');
+        if (at != std::string::npos &&
+            std::sscanf(spec.c_str() + at + 1, "%f,%f,%f,%f,%f,%f", &p[0], &p[1], &p[2], &p[3], &p[4], &p[5]) != 6) {
+            std::cerr << "Invalid sensor pose (x,y,z,roll,pitch,yaw): " << spec << std::endl;
+            return false;
+        }
+        out.extrinsics = Extrinsics::from_pose(p[0], p[1], p[2], p[3], p[4], p[5]);
+        return true;
+    }
+};
+
+// One revolution of every sensor
+struct MergedFrame {
+    LidarFrame frame;
+    std::vector<size_t> sensor_first;   // first point of sensor k in frame.cloud (absent: empty range)
+};
+
+class SensorDemux {
+private:
+    struct Sensor {
+        SensorConfig config;
+        size_t index;
+        PacketRing ring;
+        Pandar64Parser parser;
+        FrameAssembler assembler;
+        std::thread worker;
+        std::atomic<uint64_t> packets {0};
+        std::atomic<uint64_t> frames {0};
+        std::deque<LidarFrame> queue;       // guarded by merge_mtx
+        std::vector<LidarFrame> spare;      // guarded by merge_mtx
+        double last_end {-1.0};             // guarded by merge_mtx: end of the last revolution, -1 = none yet
+
+        std::shared_ptr<CalibrationStore> calibration;
+
+        Sensor(const SensorConfig& cfg, size_t idx, size_t ring_slots, OverflowPolicy policy, float cut_angle,
+               std::shared_ptr<CalibrationStore> store, const ParserOptions& options)
+            : config(cfg), index(idx), ring(ring_slots, policy), assembler(cut_angle, SENSOR_FRAME_POINTS),
+              calibration(std::move(store)) {
+            parser.configure(options);
+            if (calibration) parser.set_calibration(calibration);
+        }
+    };
+
+    const size_t ring_slots;
+    const OverflowPolicy policy;
+    const float cut_angle;
+    double align_s {SENSOR_ALIGN_S};
+    double silence_s {SENSOR_SILENCE_S};
+    bool auto_register;                     // no configured sensors: every new source becomes one
+    std::shared_ptr<CalibrationStore> default_calibration;
+    ParserOptions parser_options;           // MODEL_AUTO: each sensor detects its own
+
+    // sensor table: appended by the routing thread only, read by the merge under merge_mtx
+    std::vector<std::unique_ptr<Sensor>> sensors;
+    size_t last_routed {0};
+
+    std::mutex merge_mtx;
+    std::deque<MergedFrame> merged;
+    std::vector<MergedFrame> merged_spare;
+    std::atomic<size_t> merged_ready {0};
+    uint64_t next_id {0};
+    double newest_end {-1.0};               // guarded by merge_mtx: latest revolution end over all sensors
+    double first_start {-1.0};              // guarded by merge_mtx: start of the first revolution of any sensor
+
+    std::atomic<uint64_t> unrouted_count {0};
+    std::atomic<uint64_t> unmatched_count {0};     // revolutions without partners in time
+    std::atomic<uint64_t> overrun_count {0};       // revolutions / merged frames dropped from full queues
+    std::atomic<uint64_t> partial_count {0};       // merged frames with a silent sensor left out
+
+    Sensor* add_sensor(const SensorConfig& cfg, std::shared_ptr<CalibrationStore> store) {
+        std::unique_ptr<Sensor> s(new Sensor(cfg, sensors.size(), ring_slots, policy, cut_angle, std::move(store),
+                                           parser_options));
+        Sensor* raw = s.get();
+        {
+            std::lock_guard<std::mutex> lock(merge_mtx);
+            sensors.push_back(std::move(s));
+        }
+        raw->worker = std::thread(&SensorDemux::worker_loop, this, raw);
+        std::cerr << "[INFO] sensor " << raw->index << ": " << cfg.key.to_string() << std::endl;
+        return raw;
+    }
+
+    void worker_loop(Sensor* s) {
+        PCAP_PacketView packet;
+        while (true) {
+            if (!s->ring.wait_front(packet, 100)) {
+                if (s->ring.is_closed() && s->ring.empty()) break;
+                continue;
+            }
+            size_t first = s->assembler.cloud().size();
+            s->parser.parse_packet(packet, s->assembler.cloud());
+            s->ring.pop();
+            s->config.extrinsics.apply(s->assembler.cloud(), first);
+            s->packets.fetch_add(1, std::memory_order_relaxed);
+            if (s->assembler.commit(first, s->parser.last_tail().clock_offset)) submit(*s, s->assembler.frame());
+        }
+        if (s->assembler.flush()) submit(*s, s->assembler.frame());
+    }
+
+    static inline double middle(const LidarFrame& f) {
+        return 0.5 * (f.start_time + f.end_time);
+    }
+
+    // Copy a completed revolution into the sensor's queue and try to merge
+    void submit(Sensor& s, const LidarFrame& frame) {
+        s.frames.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(merge_mtx);
+        LidarFrame slot;
+        if (!s.spare.empty()) {
+            slot = std::move(s.spare.back());
+            s.spare.pop_back();
+        }
+        slot.cloud.clear();
+        slot.cloud.append(frame.cloud);
+        slot.frame_id = frame.frame_id;
+        slot.start_time = frame.start_time;
+        slot.end_time = frame.end_time;
+        slot.sensor_start_time = frame.sensor_start_time;
+        slot.sensor_end_time = frame.sensor_end_time;
+        slot.packet_count = frame.packet_count;
+        s.last_end = frame.end_time;
+        newest_end = std::max(newest_end, frame.end_time);
+        if (first_start < 0) first_start = frame.start_time;
+        s.queue.push_back(std::move(slot));
+        if (s.queue.size() > SENSOR_QUEUE_FRAMES) {
+            recycle(s);
+            overrun_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        try_merge();
+    }
+
+    inline void recycle(Sensor& s) {
+        s.spare.push_back(std::move(s.queue.front()));
+        s.queue.pop_front();
+    }
+
+    // merge_mtx held. Nothing queued and no revolution for silence_s (never: since the first
+    // revolution of any sensor): the merge does not wait for this sensor
+    inline bool silent(const Sensor& s) const {
+        const double last = s.last_end >= 0 ? s.last_end : first_start;
+        return s.queue.empty() && newest_end - last > silence_s;
+    }
+
+    // merge_mtx held
+    void try_merge() {
+        while (true) {
+            double ref = -1e300;
+            size_t absent = 0;
+            for (auto& s : sensors) {
+                if (silent(*s)) {
+                    absent++;
+                    continue;
+                }
+                if (s->queue.empty()) return;
+                ref = std::max(ref, middle(s->queue.front()));
+            }
+            if (absent == sensors.size()) return;
+            // revolutions too old to have a partner are dropped
+            bool stale = false;
+            for (auto& s : sensors) {
+                while (!s->queue.empty() && middle(s->queue.front()) < ref - align_s) {
+                    recycle(*s);
+                    unmatched_count.fetch_add(1, std::memory_order_relaxed);
+                    stale = true;
+                }
+            }
+            if (stale) continue;
+
+            MergedFrame out;
+            if (!merged_spare.empty()) {
+                out = std::move(merged_spare.back());
+                merged_spare.pop_back();
+            }
+            LidarFrame& f = out.frame;
+            f.cloud.clear();
+            f.start_time = 1e300;
+            f.end_time = -1e300;
+            f.sensor_start_time = 0.0;     // bounds over the sensors that report their clock
+            f.sensor_end_time = 0.0;
+            f.packet_count = 0;
+            out.sensor_first.assign(sensors.size(), 0);
+            for (auto& s : sensors) {
+                out.sensor_first[s->index] = f.cloud.size();
+                if (s->queue.empty()) continue;     // silent
+                const LidarFrame& part = s->queue.front();
+                f.cloud.append(part.cloud);
+                f.start_time = std::min(f.start_time, part.start_time);
+                f.end_time = std::max(f.end_time, part.end_time);
+                if (part.sensor_start_time != 0.0) {
+                    f.sensor_start_time = f.sensor_start_time == 0.0 ? part.sensor_start_time
+                                                                    : std::min(f.sensor_start_time, part.sensor_start_time);
+                    f.sensor_end_time = std::max(f.sensor_end_time, part.sensor_end_time);
+                }
+                f.packet_count += part.packet_count;
+                recycle(*s);
+            }
+            f.frame_id = next_id++;
+            if (absent) partial_count.fetch_add(1, std::memory_order_relaxed);
+
+            merged.push_back(std::move(out));
+            if (merged.size() > SENSOR_QUEUE_FRAMES) {
+                merged_spare.push_back(std::move(merged.front()));
+                merged.pop_front();
+                overrun_count.fetch_add(1, std::memory_order_relaxed);
+            }
+            merged_ready.store(merged.size(), std::memory_order_release);
+        }
+    }
+
+public:
+    /**
+     * @param slots So slot cua ring moi sensor.
+     * @param overflow OVERFLOW_BLOCK cho file (khong mat packet), tuy chon cho live.
+     */
+    explicit SensorDemux(size_t slots = PACKET_RING_SLOTS, OverflowPolicy overflow = OVERFLOW_BLOCK,
+                         float cut_angle_deg = 0.0f)
+        : ring_slots(slots), policy(overflow), cut_angle(cut_angle_deg), auto_register(true) {}
+
+    SensorDemux(const SensorDemux&) = delete;
+    SensorDemux& operator=(const SensorDemux&) = delete;
+
+    ~SensorDemux() {
+        finish();
+    }
+
+    // Calibration of sensors without their own file (set before add() / routing)
+    inline void set_default_calibration(std::shared_ptr<CalibrationStore> store) {
+        default_calibration = std::move(store);
+    }
+
+    // Packet model / echo selection of every sensor added from now on
+    inline void set_parser_options(const ParserOptions& options) {
+        parser_options = options;
+    }
+
+    // Route packets from this source to its own sensor; disables auto-registration.
+    // False if the sensor cannot be added (SENSOR_MAX reached, calibration file not loaded).
+    bool add(const SensorConfig& cfg) {
+        if (sensors.size() >= SENSOR_MAX) {
+            std::cerr << "[ERROR] more than " << SENSOR_MAX << " sensors, cannot add " << cfg.key.to_string() << std::endl;
+            return false;
+        }
+        std::shared_ptr<CalibrationStore> store = default_calibration;
+        if (!cfg.calibration_file.empty()) {
+            store = std::make_shared<CalibrationStore>();
+            if (parser_options.model != MODEL_AUTO) {
+                store->require_lasers(model_lasers(parser_options.model), model_name(parser_options.model));
+            }
+            if (!store->load(cfg.calibration_file)) return false;
+        }
+        auto_register = false;
+        add_sensor(cfg, store);
+        return true;
+    }
+
+    // Re-read every calibration file (shared default included); any thread
+    void reload_calibration() {
+        std::vector<std::shared_ptr<CalibrationStore>> stores;
+        {
+            std::lock_guard<std::mutex> lock(merge_mtx);
+            for (auto& s : sensors) {
+                if (s->calibration && s->calibration != default_calibration) stores.push_back(s->calibration);
+            }
+        }
+        if (default_calibration) stores.push_back(default_calibration);
+        for (auto& store : stores) store->reload();
+    }
+
+    // A sensor's calibration file does not fit the model it detected (see CalibrationStore::require_lasers)
+    bool calibration_rejected() {
+        std::lock_guard<std::mutex> lock(merge_mtx);
+        for (auto& s : sensors) {
+            if (s->calibration && s->calibration->rejected()) return true;
+        }
+        return default_calibration && default_calibration->rejected();
+    }
+
+    // Max distance between the middles of revolutions merged together (s)
+    inline void set_alignment(double seconds) {
+        align_s = seconds;
+    }
+
+    // Capture-clock time without a revolution after which a sensor is left out of the merge (s)
+    inline void set_silence_timeout(double seconds) {
+        silence_s = seconds;
+    }
+
+    //==========================================================================
+    // Routing thread (capture / file reader)
+    //==========================================================================
+    // Copy the packet into its sensor's ring. Returns false if it belongs to no sensor.
+    bool route(const PCAP_PacketView& packet) {
+        SensorKey source;
+        if (!packet_source(packet.packet_data, packet.packet_header.capture_length, source)) {
+            unrouted_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Sensor* target = nullptr;
+        if (last_routed < sensors.size() && sensors[last_routed]->config.key.matches(source)) {
+            target = sensors[last_routed].get();
+        } else {
+            for (auto& s : sensors) {
+                if (s->config.key.matches(source)) {
+                    target = s.get();
+                    break;
+                }
+            }
+            if (!target && auto_register && sensors.size() < SENSOR_MAX) {
+                SensorConfig cfg;
+                cfg.key = source;
+                target = add_sensor(cfg, default_calibration);
+            }
+            if (!target) {
+                unrouted_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            last_routed = target->index;
+        }
+        return target->ring.push(packet);
+    }
+
+    // End of input: workers drain their rings, flush the last revolution and exit
+    void finish() {
+        for (auto& s : sensors) s->ring.close();
+        for (auto& s : sensors) {
+            if (s->worker.joinable()) s->worker.join();
+        }
+    }
+
+    //==========================================================================
+    // Consumer
+    //==========================================================================
+    // Oldest merged frame. `out` keeps its buffers: they are reused for later frames.
+    bool take(MergedFrame& out) {
+        if (merged_ready.load(std::memory_order_acquire) == 0) return false;
+        std::lock_guard<std::mutex> lock(merge_mtx);
+        if (merged.empty()) return false;
+        std::swap(out, merged.front());
+        merged_spare.push_back(std::move(merged.front()));
+        merged.pop_front();
+        merged_ready.store(merged.size(), std::memory_order_release);
+        return true;
+    }
+
+    //==========================================================================
+    // Statistics
+    //==========================================================================
+    inline size_t sensor_count() const { return sensors.size(); }
+    inline SensorKey sensor_key(size_t k) const { return sensors[k]->config.key; }
+    inline uint64_t sensor_packets(size_t k) const { return sensors[k]->packets.load(); }
+    inline uint64_t sensor_frames(size_t k) const { return sensors[k]->frames.load(); }
+    inline uint64_t sensor_dropped(size_t k) const { return sensors[k]->ring.dropped(); }
+    // parse counters of one sensor, readable while its worker runs
+    inline ParseStats& sensor_stats(size_t k) const { return *sensors[k]->parser.get_stats(); }
+
+    // Periodic per-sensor parse report (ParseStats::log_if_due), safe while sensors are being added
+    void log_parse_stats_if_due(double interval_s = PARSE_STATS_LOG_S) {
+        std::lock_guard<std::mutex> lock(merge_mtx);
+        for (auto& s : sensors) {
+            if (!s->parser.get_stats()->due()) continue;
+            std::string label = "sensor " + std::to_string(s->index) + " " + s->config.key.to_string();
+            s->parser.get_stats()->log_if_due(label.c_str(), interval_s);
+        }
+    }
+    // call after finish()
+    inline uint64_t merged_frames() const { return next_id; }
+    inline uint64_t unrouted() const { return unrouted_count.load(); }
+    inline uint64_t unmatched() const { return unmatched_count.load(); }
+    inline uint64_t overruns() const { return overrun_count.load(); }
+    inline uint64_t partial() const { return partial_count.load(); }
+};
+
+#endif // SENSOR_DEMUX_H
@@ -0,0 +1,245 @@
+#pragma once
+//==============================================
+// Per-stage latency histograms
+// StageTimer measures one scope with steady_clock and records it into the
+// histogram set of the calling thread. A thread only ever writes its own set
+// (relaxed load + store, no lock, no read-modify-write); reports merge every
+// set. Buckets are HDR-style log-linear: exact below 64 ns, then 32 buckets
+// per power of two (<= 3% relative error), up to ~73 min.
+// Timing is off by default: a disabled timer costs one relaxed load.
+//==============================================
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define LATENCY_SUB_BITS    5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)      // buckets per power of two
+#define LATENCY_MAX_SHIFT   36                           // last bucket: >= 2^(36 + 6) ns
+#define LATENCY_BUCKETS     (2 * LATENCY_SUB_BUCKETS + LATENCY_MAX_SHIFT * LATENCY_SUB_BUCKETS)
+
+enum PipelineStage {
+    STAGE_CAPTURE = 0,      // pcap file record / libpcap read / recvmmsg batch (waiting for data excluded)
+    STAGE_PARSE,            // Pandar64Parser, one packet (--fused: parse + pixel projection)
+    STAGE_PACKET,           // main: whole per-packet step (parse / submit / route, frame assembly)
+    STAGE_DESKEW,           // main: de-skew of one frame
+    STAGE_FRAME,            // main: one frame to the viewer (de-skew + publish)
+    STAGE_PROJECT,          // viewer: cloud x/y -> pixel coordinates
+    STAGE_DRAW,             // viewer: clear + draw into the canvas (project included)
+    STAGE_WRITE,            // viewer: hand-off to FrameWriter
+    STAGE_IMSHOW,           // viewer: cv::imshow (waitKey pacing excluded)
+    STAGE_COUNT
+};
+
+inline const char* stage_name(PipelineStage s) {
+    static const char* const names[STAGE_COUNT] = {
+        "capture", "parse", "packet", "deskew", "frame", "project", "draw", "write", "imshow"
+    };
+    return s < STAGE_COUNT ? names[s] : "?";
+}
+
+inline int64_t latency_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Bucket of a duration (ns)
+inline int latency_bucket(uint64_t ns) {
+    if (ns < 2 * LATENCY_SUB_BUCKETS) return static_cast<int>(ns);
+    const int msb = 63 - __builtin_clzll(ns);
+    const int shift = msb - LATENCY_SUB_BITS;             // >= 1: keeps the top 6 bits
+    if (shift > LATENCY_MAX_SHIFT) return LATENCY_BUCKETS - 1;
+    return 2 * LATENCY_SUB_BUCKETS + (shift - 1) * LATENCY_SUB_BUCKETS +
+           static_cast<int>((ns >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+// Highest duration (ns) that falls into bucket b
+inline uint64_t latency_bucket_value(int b) {
+    if (b < 2 * LATENCY_SUB_BUCKETS) return static_cast<uint64_t>(b);
+    const int shift = (b - 2 * LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS + 1;
+    const uint64_t top = LATENCY_SUB_BUCKETS + (b - 2 * LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+// Histogram of one stage on one thread: single writer, any number of readers
+struct LatencyHistogram {
+    std::atomic<uint64_t> counts[LATENCY_BUCKETS];
+    std::atomic<uint64_t> samples {0};
+    std::atomic<uint64_t> sum_ns {0};
+    std::atomic<uint64_t> max_ns {0};
+
+    LatencyHistogram() {
+        for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+    }
+
+    // owner thread only
+    inline void record(uint64_t ns) {
+        std::atomic<uint64_t>& c = counts[latency_bucket(ns)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        samples.store(samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_ns.store(sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > max_ns.load(std::memory_order_relaxed)) max_ns.store(ns, std::memory_order_relaxed);
+    }
+};
+
+struct LatencySummary {
+    uint64_t samples {0};
+    double mean_ns {0.0};
+    double p50_ns {0.0};
+    double p99_ns {0.0};
+    double max_ns {0.0};
+};
+
+// Histograms of every stage for one thread
+struct ThreadLatency {
+    std::atomic<bool> in_use {false};
+    LatencyHistogram stage[STAGE_COUNT];
+};
+
+/**
+ * Tat ca histogram cua process. Moi thread lay 1 bo khi ghi lan dau va tra lai khi ket thuc
+ * (bo do duoc thread sau dung lai, so lieu giu nguyen), nen thread pool tao / huy nhieu lan
+ * khong lam registry phinh ra. Chi acquire / release / summary can khoa.
+ */
+class LatencyRegistry {
+private:
+    std::mutex mtx;
+    std::vector<std::unique_ptr<ThreadLatency>> sets;
+    std::atomic<bool> on {false};
+
+public:
+    static LatencyRegistry& instance() {
+        static LatencyRegistry registry;
+        return registry;
+    }
+
+    inline bool enabled() const {
+        return on.load(std::memory_order_relaxed);
+    }
+
+    inline void set_enabled(bool enable) {
+        on.store(enable, std::memory_order_relaxed);
+    }
+
+    ThreadLatency* acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& s : sets) {
+            bool expected = false;
+            if (s->in_use.compare_exchange_strong(expected, true)) return s.get();
+        }
+        sets.emplace_back(new ThreadLatency());
+        sets.back()->in_use.store(true);
+        return sets.back().get();
+    }
+
+    void release(ThreadLatency* set) {
+        std::lock_guard<std::mutex> lock(mtx);
+        set->in_use.store(false);
+    }
+
+    // All threads merged; samples = 0 if the stage never ran
+    LatencySummary summary(PipelineStage s) {
+        std::vector<uint64_t> merged(LATENCY_BUCKETS, 0);
+        LatencySummary out;
+        double sum = 0.0;
+        uint64_t max_ns = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& set : sets) {
+                const LatencyHistogram& h = set->stage[s];
+                if (h.samples.load(std::memory_order_relaxed) == 0) continue;
+                for (int b = 0; b < LATENCY_BUCKETS; b++) merged[b] += h.counts[b].load(std::memory_order_relaxed);
+                sum += static_cast<double>(h.sum_ns.load(std::memory_order_relaxed));
+                max_ns = std::max(max_ns, h.max_ns.load(std::memory_order_relaxed));
+            }
+        }
+        // counts, not `samples`: a writer may be between its two stores
+        for (uint64_t c : merged) out.samples += c;
+        if (out.samples == 0) return out;
+
+        const uint64_t rank50 = (out.samples * 50 + 99) / 100;
+        const uint64_t rank99 = (out.samples * 99 + 99) / 100;
+        uint64_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            if (merged[b] == 0) continue;
+            const uint64_t before = seen;
+            seen += merged[b];
+            const double value = static_cast<double>(std::min(latency_bucket_value(b), max_ns));
+            if (before < rank50 && seen >= rank50) out.p50_ns = value;
+            if (before < rank99 && seen >= rank99) {
+                out.p99_ns = value;
+                break;
+            }
+        }
+        out.mean_ns = sum / out.samples;
+        out.max_ns = static_cast<double>(max_ns);
+        return out;
+    }
+
+    // "[STAT] latency parse: 20000 samples, p50 0.83 us, p99 2.10 us, max 35.20 us" per stage that ran
+    void print(FILE* out) {
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            LatencySummary l = summary(static_cast<PipelineStage>(s));
+            if (l.samples == 0) continue;
+            std::fprintf(out, "[STAT] latency %s: %llu samples, p50 %.2f us, p99 %.2f us, max %.2f us, mean %.2f us\n",
+                         stage_name(static_cast<PipelineStage>(s)), static_cast<unsigned long long>(l.samples),
+                         l.p50_ns * 1e-3, l.p99_ns * 1e-3, l.max_ns * 1e-3, l.mean_ns * 1e-3);
+        }
+    }
+};
+
+inline bool latency_enabled() {
+    return LatencyRegistry::instance().enabled();
+}
+
+// Histogram set of the calling thread (taken on first use, returned at thread exit)
+inline ThreadLatency& thread_latency() {
+    struct Handle {
+        ThreadLatency* set;
+        Handle() : set(LatencyRegistry::instance().acquire()) {}
+        ~Handle() { LatencyRegistry::instance().release(set); }
+    };
+    static thread_local Handle handle;
+    return *handle.set;
+}
+
+inline void record_latency(PipelineStage s, uint64_t ns) {
+    thread_latency().stage[s].record(ns);
+}
+
+// Times its scope (or until stop()) into the calling thread's histogram of `stage`
+class StageTimer {
+private:
+    PipelineStage stage;
+    int64_t start;          // -1: not timing
+
+public:
+    explicit StageTimer(PipelineStage s) : stage(s), start(latency_enabled() ? latency_now_ns() : -1) {}
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        stop();
+    }
+
+    inline void stop() {
+        if (start < 0) return;
+        record_latency(stage, static_cast<uint64_t>(latency_now_ns() - start));
+        start = -1;
+    }
+
+    // Drop the measurement (e.g. a read that only timed out)
+    inline void cancel() {
+        start = -1;
+    }
+};
+
+#endif // STAGE_TIMER_H
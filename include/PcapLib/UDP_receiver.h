@@ -0,0 +1,275 @@
+#pragma once
+//==============================================
+// Native UDP source for live LiDAR streams
+// recvmmsg() pulls a whole batch of datagrams per syscall into a preallocated
+// ring of fixed-size slots. Each slot reserves room in front of the payload for
+// a synthesized Ethernet/IPv4/UDP header, so a datagram is handed out as a
+// regular PCAP_PacketView and goes through the same parse path as pcap input.
+//==============================================
+#ifndef UDP_RECEIVER_H
+#define UDP_RECEIVER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include "PCAP_capture.h"
+
+#define UDP_SLOT_SIZE      2048        // bytes per ring slot (headroom + datagram)
+#define UDP_HEADROOM       42          // Ethernet(14) + IPv4(20) + UDP(8)
+#define UDP_RING_SLOTS     1024
+#define UDP_BATCH          64          // datagrams per recvmmsg call
+#define UDP_RCVBUF_BYTES   (16 * 1024 * 1024)
+
+#ifndef SO_RXQ_OVFL
+#define SO_RXQ_OVFL 40
+#endif
+
+class UDP_receiver {
+private:
+    int sock {-1};
+    bool isOpen {false};
+    uint16_t local_port {0};
+    uint32_t local_addr {0};             // network order
+
+    size_t ring_slots {0};
+    size_t batch_size {0};
+    size_t next_slot {0};                // first slot of the next batch
+    size_t last_first {0};               // first slot of the last batch
+    size_t last_count {0};               // datagrams in the last batch
+
+    std::vector<u_char> ring;            // ring_slots * UDP_SLOT_SIZE bytes
+    std::vector<PCAP_Header> headers;    // one per slot
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+    std::vector<sockaddr_in> addrs;
+    std::vector<char> controls;          // cmsg space per batch entry
+
+    uint64_t received_count {0};
+    uint64_t truncated_count {0};
+    uint32_t kernel_drop_count {0};      // cumulative, from SO_RXQ_OVFL
+    int rcvbuf_actual {0};
+
+    static constexpr size_t CONTROL_SIZE =
+        CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(uint32_t));
+
+    inline u_char* slot(size_t i) {
+        return ring.data() + i * UDP_SLOT_SIZE;
+    }
+
+    // Ethernet/IPv4/UDP header in front of the payload, so the slot looks like a captured frame
+    void synthesize_headers(u_char* frame, const sockaddr_in& src, size_t payload_len) {
+        std::memset(frame, 0, UDP_HEADROOM);
+        frame[12] = 0x08;                                  // ethertype IPv4
+        frame[13] = 0x00;
+
+        u_char* ip = frame + 14;
+        uint16_t ip_len = static_cast<uint16_t>(20 + 8 + payload_len);
+        ip[0] = 0x45;
+        ip[2] = ip_len >> 8;
+        ip[3] = ip_len & 0xFF;
+        ip[8] = 64;                                        // TTL
+        ip[9] = 17;                                        // UDP
+        std::memcpy(ip + 12, &src.sin_addr.s_addr, 4);
+        std::memcpy(ip + 16, &local_addr, 4);
+
+        u_char* udp = ip + 20;
+        uint16_t udp_len = static_cast<uint16_t>(8 + payload_len);
+        std::memcpy(udp, &src.sin_port, 2);
+        udp[2] = local_port >> 8;
+        udp[3] = local_port & 0xFF;
+        udp[4] = udp_len >> 8;
+        udp[5] = udp_len & 0xFF;
+    }
+
+public:
+    UDP_receiver() = default;
+    UDP_receiver(const UDP_receiver&) = delete;
+    UDP_receiver& operator=(const UDP_receiver&) = delete;
+
+    ~UDP_receiver() {
+        close_socket();
+    }
+
+    //==========================================================================
+    // Bind a UDP socket (e.g. port 2368 for Pandar64) and preallocate the ring
+    //==========================================================================
+    bool open_socket(uint16_t port,
+                     const std::string& bind_address = "0.0.0.0",
+                     int rcvbuf_bytes = UDP_RCVBUF_BYTES,
+                     size_t slots = UDP_RING_SLOTS,
+                     size_t batch = UDP_BATCH)
+    {
+        close_socket();
+        if (batch == 0 || slots < batch) {
+            std::cerr << "Error when opening socket: ring must hold at least one batch" << std::endl;
+            return false;
+        }
+
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) {
+            std::cerr << "Error when opening socket: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        // SO_RCVBUFFORCE ignores rmem_max but needs CAP_NET_ADMIN; fall back to SO_RCVBUF
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf_bytes, sizeof(rcvbuf_bytes)) != 0)
+            setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf_bytes, sizeof(rcvbuf_bytes));
+        socklen_t optlen = sizeof(rcvbuf_actual);
+        getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf_actual, &optlen);
+        if (rcvbuf_actual < rcvbuf_bytes) {
+            std::cerr << "[WARN] SO_RCVBUF is " << rcvbuf_actual << " bytes (asked " << rcvbuf_bytes
+                      << "), raise net.core.rmem_max" << std::endl;
+        }
+
+        setsockopt(sock, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one));
+        setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1) {
+            std::cerr << "Error when opening socket: bad bind address " << bind_address << std::endl;
+            close_socket();
+            return false;
+        }
+        if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "Error when binding port " << port << ": " << std::strerror(errno) << std::endl;
+            close_socket();
+            return false;
+        }
+        socklen_t addrlen = sizeof(addr);
+        getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &addrlen);
+        local_port = ntohs(addr.sin_port);
+        local_addr = addr.sin_addr.s_addr;
+
+        ring_slots = slots;
+        batch_size = batch;
+        ring.assign(ring_slots * UDP_SLOT_SIZE, 0);
+        headers.assign(ring_slots, PCAP_Header{});
+        msgs.assign(batch_size, mmsghdr{});
+        iovs.assign(batch_size, iovec{});
+        addrs.assign(batch_size, sockaddr_in{});
+        controls.assign(batch_size * CONTROL_SIZE, 0);
+        next_slot = last_first = last_count = 0;
+        received_count = truncated_count = 0;
+        kernel_drop_count = 0;
+
+        isOpen = true;
+        return true;
+    }
+
+    //==========================================================================
+    // Receive up to one batch of datagrams. Waits at most timeout_ms for the
+    // first one (-1 = forever). Returns the number received (0 on timeout).
+    // Views of a batch stay valid until the ring wraps around onto its slots.
+    //==========================================================================
+    size_t receive_batch(int timeout_ms = TIMEOUT_MS) {
+        last_count = 0;
+        if (!isOpen) return 0;
+
+        pollfd pfd { sock, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready <= 0) {
+            if (ready < 0 && errno != EINTR)
+                std::cerr << "Error when polling socket: " << std::strerror(errno) << std::endl;
+            return 0;
+        }
+
+        // timed from here: the wait in poll() is not capture work
+        StageTimer timer(STAGE_CAPTURE);
+
+        // a batch never straddles the end of the ring, so views are contiguous slots
+        if (next_slot + batch_size > ring_slots) next_slot = 0;
+        size_t first = next_slot;
+
+        for (size_t m = 0; m < batch_size; m++) {
+            iovs[m].iov_base = slot(first + m) + UDP_HEADROOM;
+            iovs[m].iov_len = UDP_SLOT_SIZE - UDP_HEADROOM;
+            msghdr& h = msgs[m].msg_hdr;
+            h.msg_name = &addrs[m];
+            h.msg_namelen = sizeof(sockaddr_in);
+            h.msg_iov = &iovs[m];
+            h.msg_iovlen = 1;
+            h.msg_control = controls.data() + m * CONTROL_SIZE;
+            h.msg_controllen = CONTROL_SIZE;
+            h.msg_flags = 0;
+            msgs[m].msg_len = 0;
+        }
+
+        int n = recvmmsg(sock, msgs.data(), static_cast<unsigned int>(batch_size), MSG_DONTWAIT, nullptr);
+        if (n <= 0) {
+            timer.cancel();
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                std::cerr << "Error when receiving: " << std::strerror(errno) << std::endl;
+            return 0;
+        }
+
+        for (int m = 0; m < n; m++) {
+            msghdr& h = msgs[m].msg_hdr;
+            size_t len = msgs[m].msg_len;
+            if (h.msg_flags & MSG_TRUNC) truncated_count++;
+
+            struct timeval tv {};
+            for (cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c)) {
+                if (c->cmsg_level != SOL_SOCKET) continue;
+                if (c->cmsg_type == SO_TIMESTAMP)
+                    std::memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+                else if (c->cmsg_type == SO_RXQ_OVFL)
+                    std::memcpy(&kernel_drop_count, CMSG_DATA(c), sizeof(kernel_drop_count));
+            }
+            if (tv.tv_sec == 0) gettimeofday(&tv, nullptr);
+
+            synthesize_headers(slot(first + m), addrs[m], len);
+            uint32_t caplen = static_cast<uint32_t>(UDP_HEADROOM + len);
+            headers[first + m] = {
+                static_cast<uint32_t>(tv.tv_sec),
+                static_cast<uint32_t>(tv.tv_usec),
+                caplen, caplen
+            };
+        }
+
+        received_count += static_cast<uint64_t>(n);
+        last_first = first;
+        last_count = static_cast<size_t>(n);
+        next_slot = first + last_count;
+        return last_count;
+    }
+
+    // i-th datagram of the last batch, as a frame view for Pandar64Parser
+    inline PCAP_PacketView packet(size_t i) const {
+        size_t s = last_first + i;
+        return { headers[s], ring.data() + s * UDP_SLOT_SIZE };
+    }
+
+    void close_socket() {
+        if (sock >= 0) {
+            ::close(sock);
+            sock = -1;
+        }
+        isOpen = false;
+        last_count = 0;
+    }
+
+    inline bool is_open() const { return isOpen; }
+    inline uint16_t port() const { return local_port; }
+    inline size_t batch_count() const { return last_count; }
+    inline uint64_t received() const { return received_count; }
+    inline uint64_t truncated() const { return truncated_count; }
+    // datagrams the kernel dropped because the socket buffer was full
+    inline uint32_t kernel_drops() const { return kernel_drop_count; }
+    inline int rcvbuf_size() const { return rcvbuf_actual; }
+};
+
+#endif // UDP_RECEIVER_H
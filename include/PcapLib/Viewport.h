@@ -0,0 +1,85 @@
+#pragma once
+//==============================================
+// Viewport transform and hit raster for the fused parse-to-pixel path
+// pixel = offset - scale * R(rotation) * (x, y). With rotation 0 this is the
+// viewer's projection (W/2 - x*scale, H/2 - y*scale). RasterBuffer counts
+// points per pixel, so a frame needs no point cloud at all.
+//==============================================
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// float -> int like cvRound / cvtps2dq: nearest even, INT32_MIN when out of range or NaN
+inline int32_t pixel_round(float v) {
+    if (!(v >= -2147483648.0f && v < 2147483648.0f)) return INT32_MIN;
+    return static_cast<int32_t>(std::lrintf(v));
+}
+
+struct ViewportTransform {
+    float scale {1.0f};           // pixels per metre
+    float offset_x {0.0f};        // pixel of the sensor origin
+    float offset_y {0.0f};
+    float cos_rot {1.0f};         // rotation about the sensor z axis
+    float sin_rot {0.0f};
+
+    ViewportTransform() = default;
+
+    ViewportTransform(float pixels_per_m, float origin_x, float origin_y, float rotation_deg = 0.0f)
+        : scale(pixels_per_m), offset_x(origin_x), offset_y(origin_y) {
+        set_rotation(rotation_deg);
+    }
+
+    void set_rotation(float rotation_deg) {
+        double rad = rotation_deg * M_PI / 180.0;
+        cos_rot = static_cast<float>(std::cos(rad));
+        sin_rot = static_cast<float>(std::sin(rad));
+    }
+
+    // project n points (metres) to pixels
+    inline void apply(const float* x, const float* y, size_t n, float* sx, float* sy) const {
+        for (size_t i = 0; i < n; i++) {
+            const float xr = x[i] * cos_rot - y[i] * sin_rot;
+            const float yr = x[i] * sin_rot + y[i] * cos_rot;
+            sx[i] = offset_x - scale * xr;
+            sy[i] = offset_y - scale * yr;
+        }
+    }
+};
+
+//================ RASTER =======================
+class RasterBuffer {
+private:
+    int32_t w;
+    int32_t h;
+    std::vector<uint16_t> hits;   // points per pixel, saturating
+
+public:
+    RasterBuffer(int width, int height)
+        : w(width), h(height), hits(static_cast<size_t>(width) * height, 0) {}
+
+    inline void clear() {
+        std::fill(hits.begin(), hits.end(), 0);
+    }
+
+    // count n points given in pixel coordinates (rounded like cvRound)
+    inline void add(const float* sx, const float* sy, size_t n) {
+        uint16_t* cell = hits.data();
+        for (size_t i = 0; i < n; i++) {
+            int32_t x = pixel_round(sx[i]);
+            int32_t y = pixel_round(sy[i]);
+            if (x < 0 || x >= w || y < 0 || y >= h) continue;
+            uint16_t& c = cell[y * w + x];
+            c += (c != UINT16_MAX);
+        }
+    }
+
+    inline const uint16_t* data() const { return hits.data(); }
+    inline int width() const { return w; }
+    inline int height() const { return h; }
+};
+
+#endif // VIEWPORT_H
@@ -2,57 +2,937 @@
 #include "main.h"
 #include <vector>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "include/PcapLib/PCAP_parse.h"
 #include "include/PcapLib/PCAP_capture.h"   // nhớ include thêm
+#include "include/PcapLib/PCAP_mmap.h"
+#include "include/PcapLib/UDP_receiver.h"
+#include "include/PcapLib/FrameAssembler.h"
+#include "include/PcapLib/ParsePool.h"
+#include "include/PcapLib/PacketRing.h"
+#include "include/PcapLib/FrameWriter.h"
+#include "include/PcapLib/ReplayClock.h"
+#include "include/PcapLib/PcapIndex.h"
+#include "include/PcapLib/FlightRecorder.h"
+#include "include/PcapLib/SensorDemux.h"
+#include "include/PcapLib/Deskew.h"
 
-int main(int argc, char** argv) {
-    Lidar2DViewer viewer(SCEEN_WIDTH, SCEEN_HEIGHT);
-    std::vector<cv::Point2f> points;
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <pcap_file> [--window <packets>] [--cut <deg>] [--threads <n>] [--fps <n>]" << std::endl;
+    std::cerr << "           [--fused [--rotate <deg>]] [--speed <0.1..10, 0 = unpaced>]" << std::endl;
+    std::cerr << "           [--headless] [--out-png <pattern%06llu.png> | --out-video <file> [--video-fps <n>]]" << std::endl;
+    std::cerr << "       " << prog << " --udp <port> [--bind <ip>] | --device <ifname>" << std::endl;
+    std::cerr << "           [--cut <deg>] [--threads <n>] [--ring <slots>] [--overflow block|drop-oldest]" << std::endl;
+    std::cerr << "           [--record <dir> [--record-seconds <s>] [--record-slots <n>] [--trigger-gap <ms>]]  (dump: SIGUSR1 or key 'r')" << std::endl;
+    std::cerr << "       " << prog << " <pcap_file> | --udp <port> | --device <ifname>" << std::endl;
+    std::cerr << "           --demux | --sensor <ip[:port][@x,y,z,roll,pitch,yaw]> [--calibration <csv>] [--sensor ...]" << std::endl;
+    std::cerr << "       --calibration <csv>: Hesai angle correction (\"Laser id,Elevation,Azimuth\"), SIGHUP reloads" << std::endl;
+    std::cerr << "       --model auto|pandar64|pandar40p|xt32|vlp16: packet format (default: detected per stream)" << std::endl;
+    std::cerr << "       --returns both|strongest|last|first: echoes kept from dual-return packets (default: both)" << std::endl;
+    std::cerr << "       --poses <t,x,y,z,qx,qy,qz,qw .csv | .bin> [--pose-clock capture|sensor]: motion de-skew" << std::endl;
+    std::cerr << "       --latency [--latency-overlay]: per-stage p50/p99/max on exit (and drawn in the window)" << std::endl;
+    std::cerr << "       " << prog << " <pcap_file> [--seek-time <s> | --seek-frame <n>] ..." << std::endl;
+    std::cerr << "       " << prog << " <pcap_file> --build-index [--cut <deg>] [--threads <n>]" << std::endl;
+    std::cerr << "       " << prog << " <pcap_file> --bench-threads <max_threads>" << std::endl;
+    std::cerr << "       " << prog << " <pcap_file> --bench-lut" << std::endl;
+    std::cerr << "       " << prog << " --bench-splat" << std::endl;
+    std::cerr << "       " << prog << " --bench-deskew" << std::endl;
+}
 
-    //=============================================================
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <pcap_file>" << std::endl;
+//=============================================================
+// Do toc do replay (parse + ghep frame, khong ve) voi 1..max_threads thread
+//=============================================================
+static int run_thread_benchmark(const char* filename, size_t max_threads, float cut_angle) {
+    PCAP_mmap capture;
+    if (!capture.open_file(filename)) {
+        std::cerr << "Failed to open pcap file: " << filename << std::endl;
         return -1;
     }
 
-    const char* filename = argv[1];
-    PCAP_capture capture;
+    std::cout << "threads  packets/s     Mpoints/s  frames" << std::endl;
+    for (size_t t = 1; t <= max_threads; t++) {
+        capture.rewind();
+        ParsePool pool(t);
+        FrameAssembler assembler(cut_angle, FRAME_RESERVE_POINTS);
+        size_t packets = 0, points = 0, frames = 0;
+
+        auto on_parsed = [&](const PCAP_PacketView&, const PointCloudSoA& parsed, const PacketTail& tail) {
+            size_t first = assembler.cloud().size();
+            assembler.cloud().append(parsed);
+            points += parsed.size();
+            packets++;
+            if (assembler.commit(first, tail.clock_offset)) frames++;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        PCAP_PacketView packet;
+        while (capture.read_packet(packet)) {
+            while (!pool.try_submit(packet)) pool.drain(on_parsed, true);
+            pool.drain(on_parsed);
+        }
+        pool.finish(on_parsed);
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%7zu  %11.0f  %10.2f  %6zu\n", t, packets / sec, points / sec / 1e6, frames);
+    }
+    return 0;
+}
+
+//=============================================================
+// Giai ma Pandar64 kieu cu: cosf/sinf cho tung diem, do -> radian moi lan (doi chung cho --bench-lut)
+//=============================================================
+static size_t decode_pandar64_trig(const uint8_t* payload, size_t payload_len, const AngleCorrection& angles,
+                                   PointCloudSoA& cloud) {
+    const float dist_unit = 0.004f;
+    const uint8_t* ptr = payload + Pandar64Layout::header_bytes;
+    const uint8_t* end = payload + payload_len;
+    size_t n = 0;
+    for (int blk = 0; blk < Pandar64Layout::blocks; ++blk) {
+        if (ptr + 2 > end) break;
+        const uint16_t az_idx = (ptr[0] | (ptr[1] << 8)) % AZIMUTH_STEPS;
+        const float azimuth_deg = az_idx * 0.01f;
+        ptr += 2;
+        for (int ch = 0; ch < Pandar64Layout::lasers; ++ch, ptr += 3) {
+            if (ptr + 3 > end) break;
+            uint16_t raw_dist = ptr[0] | (ptr[1] << 8);
+            if (raw_dist == 0) continue;
+            float distance_m = raw_dist * dist_unit;
+            if (distance_m < MIN_RANGE_M) continue;
+
+            float vert_rad = angles.elevation[ch] * M_PI / 180.0f;
+            float full_az_rad = (azimuth_deg + angles.azimuth[ch]) * M_PI / 180.0f;
+            cloud.push_back(distance_m * cosf(vert_rad) * cosf(full_az_rad),
+                            distance_m * cosf(vert_rad) * sinf(full_az_rad),
+                            distance_m * sinf(vert_rad),
+                            ptr[2], static_cast<uint8_t>(ch), az_idx, 0.0);
+            n++;
+        }
+    }
+    return n;
+}
+
+//=============================================================
+// So sanh giai ma: trig tung diem va Pandar64Parser (bang LUT, scalar/SSE4.1/AVX2)
+//=============================================================
+static int run_lut_benchmark(const char* filename) {
+    PCAP_mmap capture;
     if (!capture.open_file(filename)) {
         std::cerr << "Failed to open pcap file: " << filename << std::endl;
         return -1;
     }
+    // chi cac packet Pandar64
+    std::vector<PCAP_PacketView> packets;
+    PCAP_PacketView packet;
+    while (capture.read_packet(packet)) {
+        const uint8_t* payload;
+        size_t payload_len;
+        bool vlan;
+        if (Pandar64Parser::find_udp_payload(packet.packet_data, packet.packet_header.capture_length,
+                                             payload, payload_len, vlan) &&
+            Pandar64Layout::check(payload, payload_len)) {
+            packets.push_back(packet);
+        }
+    }
+    if (packets.empty()) {
+        std::cerr << "No Pandar64 packets in " << filename << std::endl;
+        return -1;
+    }
+
+    const AngleCorrection& angles = AngleCorrection::pandar64_default();
+    const char* level_names[] = { "lut scalar", "lut sse4.1", "lut avx2" };
+    const int reps = 10;
+    PointCloudSoA cloud;
+    auto report = [&](const char* name, size_t points, double sec) {
+        std::printf("%-11s  %10.2f  %9.2f\n", name, points / sec / 1e6, sec * 1e9 / points);
+    };
+
+    std::cout << packets.size() << " packets x " << reps << std::endl;
+    std::cout << "method       Mpoints/s  ns/point" << std::endl;
+    size_t points = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+        for (const PCAP_PacketView& p : packets) {
+            const uint8_t* payload;
+            size_t payload_len;
+            bool vlan;
+            Pandar64Parser::find_udp_payload(p.packet_data, p.packet_header.capture_length, payload, payload_len, vlan);
+            cloud.clear();
+            points += decode_pandar64_trig(payload, payload_len, angles, cloud);
+        }
+    }
+    report("trig", points, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 
+    for (int level = SIMD_SCALAR; level <= detect_simd_level(); level++) {
+        Pandar64Parser parser;
+        parser.set_model(MODEL_PANDAR64);
+        parser.set_simd_level(static_cast<SimdLevel>(level));
+        points = 0;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; r++) {
+            for (const PCAP_PacketView& p : packets) {
+                cloud.clear();
+                points += parser.parse_packet(p, cloud);
+            }
+        }
+        report(level_names[level], points, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // sai so cua bang LUT so voi trig (cung thu tu diem)
     Pandar64Parser parser;
+    parser.set_model(MODEL_PANDAR64);
+    PointCloudSoA trig;
+    double max_diff = 0.0;
+    for (const PCAP_PacketView& p : packets) {
+        const uint8_t* payload;
+        size_t payload_len;
+        bool vlan;
+        Pandar64Parser::find_udp_payload(p.packet_data, p.packet_header.capture_length, payload, payload_len, vlan);
+        trig.clear();
+        decode_pandar64_trig(payload, payload_len, angles, trig);
+        cloud.clear();
+        parser.parse_packet(p, cloud);
+        if (cloud.size() != trig.size()) {
+            std::cerr << "[WARN] lut and trig decode a different number of points" << std::endl;
+            break;
+        }
+        for (size_t k = 0; k < cloud.size(); k++) {
+            max_diff = std::max({ max_diff, std::fabs(static_cast<double>(cloud.x[k]) - trig.x[k]),
+                                  std::fabs(static_cast<double>(cloud.y[k]) - trig.y[k]),
+                                  std::fabs(static_cast<double>(cloud.z[k]) - trig.z[k]) });
+        }
+    }
+    std::printf("max |lut - trig| = %.2e m\n", max_diff);
+    return 0;
+}
 
-    // đọc tất cả packet từ file
-    auto packets = capture.read_all_packets();
-    int packet_count = 0;
+//=============================================================
+// So sanh ve diem: cv::circle(FILLED) tung diem va PointSplatter (scalar/SSE4.1/AVX2)
+//=============================================================
+static int run_splat_benchmark() {
+    const int radius = 1;   // pointSize mac dinh 2 cua viewer
+    const cv::Scalar color(0, 255, 0);
+    const size_t sizes[] = { 100000, 1000000 };
+    const char* level_names[] = { "scalar", "sse4.1", "avx2" };
+    const SimdLevel best = detect_simd_level();
 
+    std::cout << "points    method    ms/frame   Mpoints/s" << std::endl;
+    for (size_t n : sizes) {
+        // phan bo quanh tam canvas, mot phan nam ngoai bien
+        std::mt19937 rng(12345);
+        std::normal_distribution<float> dist(0.0f, SCEEN_WIDTH / 4.0f);
+        std::vector<float> px(n), py(n);
+        for (size_t i = 0; i < n; i++) {
+            px[i] = SCEEN_WIDTH / 2 + dist(rng);
+            py[i] = SCEEN_HEIGHT / 2 + dist(rng);
+        }
+        const int reps = n >= 1000000 ? 5 : 20;
+        auto report = [&](const char* name, double sec) {
+            std::printf("%7zu  %-8s  %9.3f  %10.1f\n", n, name, sec * 1e3 / reps, n * reps / sec / 1e6);
+        };
 
-    for (size_t i = 0; i < packets.size(); i++) {
+        cv::Mat canvas = cv::Mat::zeros(SCEEN_HEIGHT, SCEEN_WIDTH, CV_8UC3);
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; r++) {
+            canvas.setTo(cv::Scalar(0, 0, 0));
+            for (size_t i = 0; i < n; i++) {
+                cv::circle(canvas, cv::Point2f(px[i], py[i]), radius, color, cv::FILLED);
+            }
+        }
+        report("circle", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        cv::Mat reference;
+        for (int level = SIMD_SCALAR; level <= best; level++) {
+            PointSplatter splatter(static_cast<SimdLevel>(level));
+            start = std::chrono::steady_clock::now();
+            for (int r = 0; r < reps; r++) {
+                canvas.setTo(cv::Scalar(0, 0, 0));
+                splatter.splat(canvas, px.data(), py.data(), n, color, radius);
+            }
+            report(level_names[level], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            if (level == SIMD_SCALAR) {
+                reference = canvas.clone();
+            } else if (std::memcmp(reference.data, canvas.data, canvas.total() * 3) != 0) {
+                std::cerr << "[WARN] " << level_names[level] << " canvas differs from scalar" << std::endl;
+            }
+        }
+    }
+    return 0;
+}
+
+//=============================================================
+// Do thoi gian de-skew 1 vong quay 120k diem (xe 20 m/s, quay 30 deg/s)
+//=============================================================
+static int run_deskew_benchmark() {
+    const size_t n = 120000;
+    const double rev_s = 0.1;
+    auto poses = std::make_shared<PoseStream>();
+    for (int k = 0; k <= 100; k++) {
+        Pose p;
+        p.t = k * 0.01;
+        p.p[0] = 20.0 * p.t;
+        const double yaw = 0.5 * p.t;   // ~30 deg/s
+        p.q[2] = std::sin(yaw / 2);
+        p.q[3] = std::cos(yaw / 2);
+        poses->add(p);
+    }
+
+    LidarFrame source;
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> range(1.0f, 80.0f);
+    for (size_t i = 0; i < n; i++) {
+        const uint16_t az = static_cast<uint16_t>(i * FULL_TURN_CDEG / n);
+        const float d = range(rng);
+        const double a = az * M_PI / 18000.0;
+        source.cloud.push_back(d * std::cos(a), d * std::sin(a), 0.1f * d, 0, i % 64, az, 0.2 + rev_s * i / n);
+    }
+    source.start_time = source.cloud.timestamp[0];
+    source.end_time = source.cloud.timestamp[n - 1];
+
+    const char* level_names[] = { "scalar", "sse4.1", "avx2" };
+    const int reps = 50;
+    LidarFrame frame;
+    PointCloudSoA reference;
+    std::cout << "points   level     ms/frame" << std::endl;
+    for (int level = SIMD_SCALAR; level <= detect_simd_level(); level++) {
+        MotionDeskew deskew(poses, static_cast<SimdLevel>(level));
+        for (int r = 0; r < reps; r++) {
+            frame.cloud.clear();
+            frame.cloud.append(source.cloud);
+            frame.start_time = source.start_time;
+            frame.end_time = source.end_time;
+            deskew.apply(frame);
+        }
+        std::printf("%6zu   %-8s  %8.3f (max %.3f)\n", n, level_names[level],
+                    deskew.mean_seconds() * 1e3, deskew.max_seconds() * 1e3);
+        if (level == SIMD_SCALAR) {
+            reference.clear();
+            reference.append(frame.cloud);
+        } else if (std::memcmp(reference.x.data(), frame.cloud.x.data(), n * sizeof(float)) != 0 ||
+                   std::memcmp(reference.y.data(), frame.cloud.y.data(), n * sizeof(float)) != 0 ||
+                   std::memcmp(reference.z.data(), frame.cloud.z.data(), n * sizeof(float)) != 0) {
+            std::cerr << "[WARN] " << level_names[level] << " de-skew differs from scalar" << std::endl;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+
+    //=============================================================
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    const char* filename = nullptr;
+    int udp_port = -1;
+    std::string bind_address = "0.0.0.0";
+    size_t window_size = STREAM_WINDOW;
+    float cut_angle = 0.0f;
+    size_t threads = 1;
+    size_t bench_threads = 0;
+    bool bench_lut = false;
+    const char* device = nullptr;
+    size_t ring_slots = PACKET_RING_SLOTS;
+    OverflowPolicy overflow_policy = OVERFLOW_BLOCK;
+    double render_fps = RENDER_FPS;
+    bool bench_splat = false;
+    bool bench_deskew = false;
+    const char* pose_path = nullptr;
+    bool pose_sensor_clock = false;
+    bool latency = false;
+    bool latency_overlay = false;
+    bool fused = false;
+    float view_rotation = 0.0f;
+    bool headless = false;
+    const char* out_png = nullptr;
+    const char* out_video = nullptr;
+    double video_fps = VIDEO_FPS;
+    double replay_speed = 0.0;
+    bool build_index = false;
+    double seek_time = -1.0;
+    long seek_frame = -1;
+    const char* record_dir = nullptr;
+    double record_seconds = FLIGHT_WINDOW_S;
+    size_t record_slots = 0;    // 0: sized from record_seconds
+    double trigger_gap_ms = 0.0;
+    bool demux_sensors = false;
+    std::vector<SensorConfig> sensor_configs;
+    const char* calibration_path = nullptr;
+    ParserOptions parser_options;
+    for (int a = 1; a < argc; a++) {
+        if (std::strcmp(argv[a], "--window") == 0 && a + 1 < argc) {
+            window_size = std::strtoul(argv[++a], nullptr, 10);
+        } else if (std::strcmp(argv[a], "--udp") == 0 && a + 1 < argc) {
+            char* end = nullptr;
+            long port = std::strtol(argv[++a], &end, 10);
+            if (end == argv[a] || *end != '\0' || port < 1 || port > 65535) {
+                std::cerr << "Invalid UDP port: " << argv[a] << " (1..65535)" << std::endl;
+                return -1;
+            }
+            udp_port = static_cast<int>(port);
+        } else if (std::strcmp(argv[a], "--cut") == 0 && a + 1 < argc) {
+            cut_angle = static_cast<float>(std::atof(argv[++a]));
+        } else if (std::strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            threads = std::strtoul(argv[++a], nullptr, 10);
+        } else if (std::strcmp(argv[a], "--bench-threads") == 0 && a + 1 < argc) {
+            bench_threads = std::strtoul(argv[++a], nullptr, 10);
+        } else if (std::strcmp(argv[a], "--bench-lut") == 0) {
+            bench_lut = true;
+        } else if (std::strcmp(argv[a], "--device") == 0 && a + 1 < argc) {
+            device = argv[++a];
+        } else if (std::strcmp(argv[a], "--ring") == 0 && a + 1 < argc) {
+            ring_slots = std::strtoul(argv[++a], nullptr, 10);
+        } else if (std::strcmp(argv[a], "--overflow") == 0 && a + 1 < argc) {
+            overflow_policy = std::strcmp(argv[++a], "drop-oldest") == 0 ? OVERFLOW_DROP_OLDEST : OVERFLOW_BLOCK;
+        } else if (std::strcmp(argv[a], "--demux") == 0) {
+            demux_sensors = true;
+        } else if (std::strcmp(argv[a], "--sensor") == 0 && a + 1 < argc) {
+            SensorConfig cfg;
+            if (!SensorConfig::parse(argv[++a], cfg)) return -1;
+            sensor_configs.push_back(cfg);
+            demux_sensors = true;
+        } else if (std::strcmp(argv[a], "--calibration") == 0 && a + 1 < argc) {
+            // sau --sensor: calibration cua sensor do; truoc / khong co --sensor: dung chung
+            if (!sensor_configs.empty()) sensor_configs.back().calibration_file = argv[++a];
+            else calibration_path = argv[++a];
+        } else if (std::strcmp(argv[a], "--model") == 0 && a + 1 < argc) {
+            if (!parse_model_name(argv[++a], parser_options.model)) {
+                std::cerr << "Unknown model: " << argv[a] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[a], "--returns") == 0 && a + 1 < argc) {
+            if (!parse_return_selection(argv[++a], parser_options.returns)) {
+                std::cerr << "Unknown return selection: " << argv[a] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[a], "--record") == 0 && a + 1 < argc) {
+            record_dir = argv[++a];
+        } else if (std::strcmp(argv[a], "--record-seconds") == 0 && a + 1 < argc) {
+            record_seconds = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--record-slots") == 0 && a + 1 < argc) {
+            record_slots = std::strtoul(argv[++a], nullptr, 10);
+        } else if (std::strcmp(argv[a], "--trigger-gap") == 0 && a + 1 < argc) {
+            trigger_gap_ms = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--build-index") == 0) {
+            build_index = true;
+        } else if (std::strcmp(argv[a], "--seek-time") == 0 && a + 1 < argc) {
+            seek_time = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--seek-frame") == 0 && a + 1 < argc) {
+            seek_frame = std::atol(argv[++a]);
+        } else if (std::strcmp(argv[a], "--speed") == 0 && a + 1 < argc) {
+            replay_speed = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--headless") == 0) {
+            headless = true;
+        } else if (std::strcmp(argv[a], "--out-png") == 0 && a + 1 < argc) {
+            out_png = argv[++a];
+        } else if (std::strcmp(argv[a], "--out-video") == 0 && a + 1 < argc) {
+            out_video = argv[++a];
+        } else if (std::strcmp(argv[a], "--video-fps") == 0 && a + 1 < argc) {
+            video_fps = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--fused") == 0) {
+            fused = true;
+        } else if (std::strcmp(argv[a], "--rotate") == 0 && a + 1 < argc) {
+            view_rotation = static_cast<float>(std::atof(argv[++a]));
+        } else if (std::strcmp(argv[a], "--bench-splat") == 0) {
+            bench_splat = true;
+        } else if (std::strcmp(argv[a], "--bench-deskew") == 0) {
+            bench_deskew = true;
+        } else if (std::strcmp(argv[a], "--poses") == 0 && a + 1 < argc) {
+            pose_path = argv[++a];
+        } else if (std::strcmp(argv[a], "--pose-clock") == 0 && a + 1 < argc) {
+            pose_sensor_clock = std::strcmp(argv[++a], "sensor") == 0;
+        } else if (std::strcmp(argv[a], "--latency") == 0) {
+            latency = true;
+        } else if (std::strcmp(argv[a], "--latency-overlay") == 0) {
+            latency = latency_overlay = true;
+        } else if (std::strcmp(argv[a], "--fps") == 0 && a + 1 < argc) {
+            render_fps = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--bind") == 0 && a + 1 < argc) {
+            bind_address = argv[++a];
+        } else if (argv[a][0] != '-' && !filename) {
+            filename = argv[a];
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if (window_size == 0) window_size = 1;
+    if (bench_splat) {
+        return run_splat_benchmark();
+    }
+    if (bench_deskew) {
+        return run_deskew_benchmark();
+    }
+    if (!filename && udp_port < 0 && !device) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    if (bench_threads > 0) {
+        if (!filename) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return run_thread_benchmark(filename, bench_threads, cut_angle);
+    }
+    if (bench_lut) {
+        if (!filename) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        return run_lut_benchmark(filename);
+    }
 
-        const auto& packet = packets[i];   // lấy packet theo index
-        auto cloud = parser.parse_packet(packet);
-        if (!cloud.empty()) {
-            points.clear();  // reset point list cho packet mới
-            for (size_t j = 0; j < cloud.size(); j++) {
-                const auto& p = cloud[j];
-                points.push_back(cv::Point2f(
-                    (SCEEN_WIDTH /2) - p.x*SCALE,
-                    (SCEEN_HEIGHT /2) - p.y*SCALE
-                ));
+    // index sidecar (<file>.idx): tao khi --build-index, hoac khi seek ma chua co / da cu
+    PcapIndex index;
+    if (build_index || seek_time >= 0 || seek_frame >= 0) {
+        if (!filename) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        const std::string index_path = PcapIndex::sidecar_path(filename);
+        struct stat st;
+        bool fresh = !build_index && ::stat(filename, &st) == 0 &&
+                     index.load(index_path, static_cast<uint64_t>(st.st_size), cut_angle);
+        if (!fresh) {
+            size_t index_threads = threads > 1 ? threads : std::max(1u, std::thread::hardware_concurrency());
+            auto start = std::chrono::steady_clock::now();
+            if (!index.build(filename, index_threads, cut_angle)) {
+                std::cerr << "Failed to index pcap file: " << filename << std::endl;
+                return -1;
             }
-            viewer.update(points);
-            viewer.show();
-            cv::waitKey(1);   // xử lý GUI
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            index.save(index_path);
+            std::printf("[STAT] index: %llu packets, %zu time entries, %zu frames in %.3f s (%zu threads) -> %s\n",
+                        static_cast<unsigned long long>(index.packets()), index.time_entries(),
+                        index.frame_count(), sec, index_threads, index_path.c_str());
+        }
+        if (build_index) return 0;
+    }
+
+    // do thoi gian tung stage (capture, parse, ve, imshow ...) -> p50/p99/max luc ket thuc
+    LatencyRegistry::instance().set_enabled(latency);
+
+    // headless: khong cua so, replay nhanh nhat co the; frame chi duoc ve khi ghi ra file
+    Lidar2DViewer viewer(SCEEN_WIDTH, SCEEN_HEIGHT, headless);
+    viewer.set_latency_overlay(latency_overlay);
+    // ve o thread rieng voi tan so co dinh: xu ly khong bao gio cho GUI
+    if (render_fps > 0 && !headless) viewer.start_render(render_fps);
+
+    // ghi frame ra PNG / video tren thread encoder rieng
+    FrameWriter writer;
+    if (out_png) {
+        if (!writer.open_png(out_png)) return -1;
+    } else if (out_video && !writer.open_video(out_video, video_fps, cv::Size(SCEEN_WIDTH, SCEEN_HEIGHT))) {
+        return -1;
+    }
+    if (writer.is_open()) viewer.set_frame_writer(&writer);
+
+    // goc laser cua tung sensor; SIGHUP doc lai file ma khong dung phien live
+    std::shared_ptr<CalibrationStore> calibration;
+    bool reloadable = false;
+    if (calibration_path) {
+        calibration = std::make_shared<CalibrationStore>();
+        // --model: so laser cua file duoc kiem tra ngay; auto: khi parser nhan dien xong model
+        if (parser_options.model != MODEL_AUTO) {
+            calibration->require_lasers(model_lasers(parser_options.model), model_name(parser_options.model));
+        }
+        if (!calibration->load(calibration_path)) return -1;
+        reloadable = true;
+    }
+    for (const auto& cfg : sensor_configs) reloadable |= !cfg.calibration_file.empty();
+    if (!calibration_path && sensor_configs.empty() && (parser_options.model == MODEL_AUTO || parser_options.model == MODEL_PANDAR64)) {
+        std::cerr << "[WARN] no --calibration: built-in Pandar64 angles (laser 64 elevation missing, 0 deg)" << std::endl;
+    }
+    if (reloadable) CalibrationStore::install_reload_signal(SIGHUP);
+
+    Pandar64Parser parser;
+    parser.configure(parser_options);
+    if (calibration) parser.set_calibration(calibration);
+    size_t i = 0;   // chi so packet toan cuc
+    size_t total_points = 0;
+
+    // threads > 1: parse song song, ket qua tra ve dung thu tu packet
+    std::unique_ptr<ParsePool> pool;
+    if (threads > 1 && !fused) pool.reset(new ParsePool(threads, PARSE_POOL_SLOTS, calibration, parser_options));
+    if (threads > 1 && fused) std::cerr << "[WARN] --fused parses on one thread, --threads ignored" << std::endl;
+
+    // nhieu sensor: tach packet theo IP/port nguon, moi sensor 1 parser + thread rieng,
+    // cac vong quay gan nhau ve thoi gian duoc ghep thanh 1 frame
+    std::unique_ptr<SensorDemux> demux;
+    if (demux_sensors) {
+        if (fused) std::cerr << "[WARN] --fused is single-sensor, ignored with --demux / --sensor" << std::endl;
+        if (threads > 1) std::cerr << "[WARN] one parse thread per sensor with --demux, --threads ignored" << std::endl;
+        fused = false;
+        pool.reset();
+        demux.reset(new SensorDemux(ring_slots, (udp_port >= 0 || device) ? overflow_policy : OVERFLOW_BLOCK,
+                                    cut_angle));
+        demux->set_default_calibration(calibration);
+        demux->set_parser_options(parser_options);
+        for (const auto& cfg : sensor_configs) {
+            if (!demux->add(cfg)) return -1;
+        }
+    }
+
+    // de-skew moi vong quay ve pose cuoi vong (can point cloud: khong dung voi --fused)
+    std::unique_ptr<MotionDeskew> deskew;
+    if (pose_path) {
+        auto poses = std::make_shared<PoseStream>();
+        if (!poses->load(pose_path)) return -1;
+        if (fused) {
+            std::cerr << "[WARN] --fused draws without a point cloud, --poses ignored" << std::endl;
         } else {
-            std::cerr << "No points in packet #" << i << std::endl;
+            deskew.reset(new MotionDeskew(poses));
+            deskew->set_sensor_clock(pose_sensor_clock);
+        }
+    }
+
+    // counter cua parser (1 sensor: parser chinh hoac ca pool; --demux: moi sensor 1 bo)
+    std::shared_ptr<ParseStats> parse_stats = pool ? pool->parse_stats() : parser.get_stats();
+    auto log_parse_stats = [&] {
+        if (demux) demux->log_parse_stats_if_due();
+        else parse_stats->log_if_due("stream");
+    };
+    auto print_parse_stats = [&] {
+        if (demux) return;   // per sensor, in print_demux_stats()
+        std::printf("[STAT] parse: ");
+        parse_stats->snapshot().print(stdout);
+        std::printf("\n");
+    };
+
+    MergedFrame merged;
+    auto print_demux_stats = [&] {
+        for (size_t k = 0; k < demux->sensor_count(); k++) {
+            std::printf("[STAT] sensor %zu %s: %llu packets, %llu frames, %llu dropped\n", k,
+                        demux->sensor_key(k).to_string().c_str(),
+                        static_cast<unsigned long long>(demux->sensor_packets(k)),
+                        static_cast<unsigned long long>(demux->sensor_frames(k)),
+                        static_cast<unsigned long long>(demux->sensor_dropped(k)));
+            std::printf("[STAT] sensor %zu parse: ", k);
+            demux->sensor_stats(k).snapshot().print(stdout);
+            std::printf("\n");
+        }
+        std::printf("[STAT] demux: %llu merged frames (%llu partial), %llu unmatched revolutions, %llu overruns, "
+                    "%llu unrouted packets\n",
+                    static_cast<unsigned long long>(demux->merged_frames()),
+                    static_cast<unsigned long long>(demux->partial()),
+                    static_cast<unsigned long long>(demux->unmatched()),
+                    static_cast<unsigned long long>(demux->overruns()),
+                    static_cast<unsigned long long>(demux->unrouted()));
+    };
+
+    // packet duoc parse thang vao frame dang ghep; buffer frame dung lai, khong cap phat heap nua
+    FrameAssembler assembler(cut_angle, FRAME_RESERVE_POINTS);
+    uint64_t warmup_allocations = 0;
+
+    // do tre: gio bat packet - gio sensor (tail) cua diem cuoi frame
+    size_t latency_frames = 0;
+    double latency_sum = 0.0, latency_max = -1e300;
+
+    // gui 1 vong quay hoan chinh cho viewer (khong cho, frame moi nhat thang)
+    auto draw_frame = [&](LidarFrame& frame) {
+        StageTimer frame_timer(STAGE_FRAME);
+        if (deskew) {
+            StageTimer timer(STAGE_DESKEW);
+            deskew->apply(frame);
+        }
+        if (frame.sensor_end_time != 0.0) {
+            double latency = frame.end_time - frame.sensor_end_time;
+            latency_sum += latency;
+            latency_max = std::max(latency_max, latency);
+            latency_frames++;
         }
-        if (i%360==0) {
-            viewer.clear_all_pixel();
+        // viewer chi doc cot x, y cua cloud: (SCEEN_WIDTH/2 - x*SCALE, SCEEN_HEIGHT/2 - y*SCALE)
+        viewer.publish(frame.cloud, SCALE);
+    };
+
+    // sau khi parse 1 packet (diem da nam trong assembler.cloud() tu chi so first)
+    // (packet khong co diem: chi dem trong ParseStats, khong in)
+    auto after_parse = [&](size_t first, const PacketTail& tail) {
+        total_points += assembler.cloud().size() - first;
+        if (assembler.commit(first, tail.clock_offset)) {
+            draw_frame(assembler.frame());
+        }
+        if (i == STREAM_WINDOW) {
+            warmup_allocations = soa_allocation_counter().load();
+        }
+        i++;
+    };
+
+    // ket qua tu pool (theo thu tu) -> chep vao frame dang ghep
+    auto on_parsed = [&](const PCAP_PacketView&, const PointCloudSoA& parsed, const PacketTail& tail) {
+        size_t first = assembler.cloud().size();
+        assembler.cloud().append(parsed);
+        after_parse(first, tail);
+    };
+
+    // --fused: parser ghi thang ra raster pixel, khong co point cloud trung gian (chi de hien thi)
+    const ViewportTransform viewport(SCALE, SCEEN_WIDTH / 2, SCEEN_HEIGHT / 2, view_rotation);
+    RasterBuffer raster(fused ? SCEEN_WIDTH : 0, fused ? SCEEN_HEIGHT : 0);
+    AzimuthWrapDetector fused_wrap(cut_angle);
+    bool fused_synced = false;   // vong quay dau tien khong du: bo
+    auto process_fused = [&](const PCAP_PacketView& packet) {
+        total_points += parser.project_packet(packet, viewport, [&](const float* sx, const float* sy, size_t n, uint16_t az) {
+            if (fused_wrap.update(az)) {
+                if (fused_synced) viewer.publish(raster);
+                fused_synced = true;
+                raster.clear();
+            }
+            raster.add(sx, sy, n);
+        });
+        i++;
+    };
+
+    // SIGHUP: doc lai file calibration, parser nhan bang moi truoc packet ke tiep
+    auto check_reload = [&] {
+        if (!CalibrationStore::reload_flag().load(std::memory_order_relaxed)) return;
+        CalibrationStore::reload_flag().store(false);
+        if (demux) demux->reload_calibration();   // default store included
+        else if (calibration) calibration->reload();
+    };
+
+    // calibration file with the wrong laser count for the detected model: hard error
+    auto calibration_rejected = [&] {
+        return (calibration && calibration->rejected()) || (demux && demux->calibration_rejected());
+    };
+
+    // frame da ghep tu cac sensor -> viewer
+    auto draw_merged = [&] {
+        while (demux->take(merged)) {
+            total_points += merged.frame.cloud.size();
+            draw_frame(merged.frame);
         }
+    };
+
+    // parse 1 packet, dung chung cho nguon pcap va UDP; stage sau chay 1 lan moi frame
+    bool copy_packets = false;   // nguon tai su dung buffer -> pool phai giu ban sao
+    auto process_packet = [&](const PCAP_PacketView& packet) {
+        StageTimer timer(STAGE_PACKET);
+        if (demux) {
+            demux->route(packet);
+            draw_merged();
+            if (i == STREAM_WINDOW) warmup_allocations = soa_allocation_counter().load();
+            i++;
+            return;
+        }
+        if (fused) {
+            process_fused(packet);
+            return;
+        }
+        if (pool) {
+            while (!pool->try_submit(packet, copy_packets)) pool->drain(on_parsed, true);
+            pool->drain(on_parsed);
+            return;
+        }
+        size_t first = assembler.cloud().size();
+        parser.parse_packet(packet, assembler.cloud());
+        after_parse(first, parser.last_tail());
+    };
+
+    if (udp_port >= 0 || device) {
+        // live: thread capture chi doc socket/pcap va day vao ring SPSC,
+        // GUI (waitKey, ve) o thread nay khong bao gio lam nghen viec nhan packet
+        UDP_receiver receiver;
+        PCAP_capture live;
+        if (udp_port >= 0) {
+            if (!receiver.open_socket(static_cast<uint16_t>(udp_port), bind_address)) {
+                std::cerr << "Failed to open UDP port: " << udp_port << std::endl;
+                return -1;
+            }
+        } else if (!live.open_device(device)) {
+            std::cerr << "Failed to open device: " << device << std::endl;
+            return -1;
+        }
+
+        // --record: giu N giay packet tho gan nhat, ghi ra pcap khi co trigger (thread rieng)
+        std::unique_ptr<FlightRecorder> recorder;
+        if (record_dir) {
+            recorder.reset(new FlightRecorder(record_slots, record_seconds));
+            recorder->set_gap_trigger(trigger_gap_ms * 1e-3);
+            recorder->start(record_dir, udp_port >= 0 ? DLT_EN10MB : live.datalink());
+            FlightRecorder::install_signal_trigger(SIGUSR1);
+        }
+
+        PacketRing ring(ring_slots, overflow_policy);
+        std::atomic<bool> running {true};
+        std::thread capture_thread([&] {
+            if (udp_port >= 0) {
+                while (running.load(std::memory_order_relaxed)) {
+                    size_t count = receiver.receive_batch(100);
+                    if (count == 0 && recorder) recorder->poll();   // silent: triggers still dump
+                    for (size_t k = 0; k < count; k++) {
+                        if (recorder) recorder->record(receiver.packet(k));
+                        if (demux) demux->route(receiver.packet(k));
+                        else ring.push(receiver.packet(k));
+                    }
+                }
+            } else {
+                PCAP_PacketView view;
+                while (running.load(std::memory_order_relaxed)) {
+                    if (!live.read_packet(view)) {
+                        if (recorder) recorder->poll();
+                        continue;
+                    }
+                    if (recorder) recorder->record(view);
+                    if (demux) demux->route(view);
+                    else ring.push(view);
+                }
+            }
+            ring.close();
+        });
+
+        copy_packets = true;   // slot cua ring duoc tai su dung ngay sau pop()
+        auto last_report = std::chrono::steady_clock::now();
+        PCAP_PacketView packet;
+        while (!(ring.is_closed() && ring.empty())) {
+            if (demux) {
+                // capture thread routes straight to the sensor workers
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                draw_merged();
+            } else if (ring.wait_front(packet, 100)) {
+                process_packet(packet);
+                ring.pop();
+            } else if (pool) {
+                pool->finish(on_parsed);   // het du lieu: giao not packet con lai
+            }
+            if (recorder && viewer.poll_key() == 'r') recorder->trigger();
+            check_reload();
+            log_parse_stats();
+            if (calibration_rejected()) break;
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_report > std::chrono::seconds(5)) {
+                last_report = now;
+                std::cerr << "[STAT] ring depth=" << ring.size() << "/" << ring.capacity()
+                          << " high-water=" << ring.high_water_mark()
+                          << " overflows=" << ring.overflows()
+                          << " dropped=" << ring.dropped();
+                if (udp_port >= 0) std::cerr << " kernel-drops=" << receiver.kernel_drops();
+                std::cerr << std::endl;
+            }
+        }
+        // the consumer may have left early (calibration rejected): a blocked push() only
+        // returns once the ring is closed, so close it before waiting for the capture thread
+        ring.close();
+        running.store(false);
+        capture_thread.join();
+        if (demux) {
+            demux->finish();
+            print_demux_stats();
+        }
+        print_parse_stats();
+        if (latency) LatencyRegistry::instance().print(stdout);
+        if (recorder) {
+            recorder->stop();
+            std::cerr << "[STAT] flight recorder: " << recorder->triggers() << " triggers, "
+                      << recorder->dumps() << " dumps, " << recorder->deferred() << " deferred, "
+                      << recorder->truncated() << " truncated packets" << std::endl;
+        }
+        return calibration_rejected() ? -1 : 0;
+    }
+
+    PCAP_mmap capture;
+    if (!capture.open_file(filename)) {
+        std::cerr << "Failed to open pcap file: " << filename << std::endl;
+        return -1;
+    }
+    if (seek_frame >= 0 && !index.seek_frame(capture, static_cast<size_t>(seek_frame))) {
+        std::cerr << "Frame " << seek_frame << " out of range (" << index.frame_count() << " frames)" << std::endl;
+        return -1;
+    }
+    if (seek_frame < 0 && seek_time >= 0 && !index.seek_time(capture, index.start_time() + seek_time)) {
+        std::cerr << "Time " << seek_time << " s is past the end of the capture" << std::endl;
+        return -1;
     }
 
-    capture.close_device();
+    // packet la view vao file da mmap: khong copy, khong cap phat moi packet.
+    // Sau moi cua so packet, tra lai cac trang da doc -> RSS khong phu thuoc kich thuoc file
+    // --speed: giao packet theo timestamp capture (x speed), mac dinh chay nhanh nhat co the
+    ReplayClock replay_clock(replay_speed);
+    PCAP_PacketView packet;
+    size_t read_count = 0;
+    auto replay_start = std::chrono::steady_clock::now();
+    while (capture.read_packet(packet)) {
+        replay_clock.wait(packet.packet_header);
+        check_reload();
+        process_packet(packet);
+        if (++read_count % window_size == 0) {
+            capture.release_consumed();
+        }
+        if (read_count % 256 == 0) {
+            log_parse_stats();
+            if (calibration_rejected()) return -1;
+        }
+    }
+    if (calibration_rejected()) return -1;
+
+    if (pool) pool->finish(on_parsed);
+    capture.close_file();
+    if (demux) {
+        demux->finish();
+        draw_merged();
+    } else if (fused) {
+        viewer.publish(raster);
+    } else if (assembler.flush()) {
+        draw_frame(assembler.frame());
+    }
+    double replay_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+    // doi encoder ghi xong, thoi gian replay o tren khong tinh phan nay
+    viewer.set_frame_writer(nullptr);
+    writer.close();
+    double total_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+
+    std::printf("[STAT] replay: %zu packets, %zu points, %llu frames in %.3f s "
+                "(%.0f packets/s, %.2f Mpoints/s, %.1f frames/s)\n",
+                i, total_points, static_cast<unsigned long long>(viewer.published_frames()), replay_sec,
+                i / replay_sec, total_points / replay_sec / 1e6, viewer.published_frames() / replay_sec);
+    if (replay_clock.paced()) {
+        std::printf("[STAT] pacing %.2fx: lateness mean %.1f us, max %.1f us, %llu of %llu packets > %d us, "
+                    "%llu gaps skipped\n",
+                    replay_clock.get_speed(), replay_clock.mean_lateness() * 1e6, replay_clock.max_lateness() * 1e6,
+                    static_cast<unsigned long long>(replay_clock.late_packets()),
+                    static_cast<unsigned long long>(replay_clock.packets()), REPLAY_LATE_US,
+                    static_cast<unsigned long long>(replay_clock.gaps_skipped()));
+    }
+    if (demux) print_demux_stats();
+    print_parse_stats();
+    if (latency_frames > 0) {
+        std::printf("[STAT] sensor clock: %zu frames, capture - sensor time mean %.3f ms, max %.3f ms\n",
+                    latency_frames, latency_sum / latency_frames * 1e3, latency_max * 1e3);
+    }
+    if (out_png || out_video) {
+        std::printf("[STAT] output: %llu frames written, %llu failed, encode %.3f s, "
+                    "%llu renderer waits, total %.3f s\n",
+                    static_cast<unsigned long long>(writer.written()),
+                    static_cast<unsigned long long>(writer.failed()),
+                    writer.encode_seconds(), static_cast<unsigned long long>(writer.waits()), total_sec);
+    }
+    std::cout << "[STAT] point buffer allocations: " << soa_allocation_counter().load()
+              << " total, " << (i > STREAM_WINDOW ? soa_allocation_counter().load() - warmup_allocations : 0)
+              << " after the first " << STREAM_WINDOW << " packets" << std::endl;
+    if (deskew) {
+        std::printf("[STAT] deskew: %llu frames, %llu without poses, %llu sectors in pose gaps, "
+                    "mean %.3f ms, max %.3f ms\n",
+                    static_cast<unsigned long long>(deskew->frames()),
+                    static_cast<unsigned long long>(deskew->skipped()),
+                    static_cast<unsigned long long>(deskew->sector_misses()),
+                    deskew->mean_seconds() * 1e3, deskew->max_seconds() * 1e3);
+    }
+    std::cout << "[STAT] frames published: " << viewer.published_frames()
+              << ", presented: " << viewer.presented_frames()
+              << ", skipped: " << viewer.skipped_frames() << std::endl;
+    if (latency) {
+        std::fflush(stdout);
+        LatencyRegistry::instance().print(stdout);
+    }
     return 0;
 }
@@ -9,4 +9,16 @@
 #define SCEEN_WIDTH   980
 
 #define SCALE 25
+
+// tan so ve cua render thread (frame/s), 0 = ve ngay tren thread xu ly
+#define RENDER_FPS 30
+
+// tan so frame cua video xuat ra (Pandar64 quay 10 vong/s)
+#define VIDEO_FPS 10
+
+// so packet doc truoc moi lan xu ly khi replay (streaming window)
+#define STREAM_WINDOW 256
+
+// so diem du tru cho buffer frame (1 vong quay Pandar64 dual return ~ 600 packet x 384 diem)
+#define FRAME_RESERVE_POINTS (600 * 384)
 #endif //MAIN_H
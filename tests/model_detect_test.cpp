@@ -0,0 +1,123 @@
+//==============================================
+// Stream model detection
+// detect_model() on full packets of every layout, on a VLP-16 packet whose
+// block 1 data bytes read FF EE where a Pandar40P block flag would be
+// (record 6 intensity 255, record 7 distance low byte 0xEE), and on
+// truncated packets of the models without header. Then the same VLP-16
+// packet through Pandar64Parser in MODEL_AUTO: the stream must lock to VLP-16.
+//==============================================
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "PcapLib/PCAP_parse.h"
+
+#define TEST_HEADERS_BYTES  42      // Ethernet + IPv4 + UDP
+
+// payload of `bytes` with the 0xFFEE flag and an azimuth in front of each of `blocks` blocks
+static std::vector<uint8_t> flagged_payload(size_t bytes, int blocks, size_t block_bytes) {
+    std::vector<uint8_t> p(bytes, 0);
+    for (int b = 0; b < blocks; b++) {
+        uint8_t* blk = p.data() + b * block_bytes;
+        blk[0] = 0xFF;
+        blk[1] = 0xEE;
+        blk[2] = static_cast<uint8_t>(b * 20);
+    }
+    return p;
+}
+
+// VLP-16 packet with records of 10 m; block 1 reads FF EE at payload offset 124
+static std::vector<uint8_t> make_vlp16() {
+    const size_t block_bytes = layout_block_bytes<VLP16Layout>();
+    std::vector<uint8_t> p = flagged_payload(VLP16Layout::payload_bytes, VLP16Layout::blocks, block_bytes);
+    for (int b = 0; b < VLP16Layout::blocks; b++) {
+        uint8_t* rec = p.data() + b * block_bytes + 4;
+        for (int r = 0; r < VLP16Layout::firings * VLP16Layout::lasers; r++, rec += VLP16Layout::record_bytes) {
+            rec[0] = 5000 & 0xFF;
+            rec[1] = 5000 >> 8;
+            rec[2] = 100;
+        }
+    }
+    uint8_t* bright = p.data() + block_bytes + 4 + 6 * VLP16Layout::record_bytes;
+    bright[2] = 0xFF;                               // record 6 intensity
+    bright[3] = 0xEE;                               // record 7 distance, low byte
+    p[VLP16Layout::return_mode_offset] = RETURN_MODE_STRONGEST;
+    return p;
+}
+
+static std::vector<uint8_t> make_pandar40p() {
+    return flagged_payload(Pandar40PLayout::payload_bytes, Pandar40PLayout::blocks,
+                           layout_block_bytes<Pandar40PLayout>());
+}
+
+static std::vector<uint8_t> make_pandar64() {
+    std::vector<uint8_t> p(1194, 0);
+    p[0] = 0xEE;
+    p[1] = 0xFF;
+    p[2] = Pandar64Layout::lasers;
+    p[3] = Pandar64Layout::blocks;
+    return p;
+}
+
+static std::vector<uint8_t> make_xt32() {
+    std::vector<uint8_t> p(1080, 0);
+    p[0] = 0xEE;
+    p[1] = 0xFF;
+    p[6] = PandarXT32Layout::lasers;
+    p[7] = PandarXT32Layout::blocks;
+    return p;
+}
+
+static int expect_model(const char* what, const std::vector<uint8_t>& p, size_t len, LidarModel expected) {
+    const LidarModel m = detect_model(p.data(), len);
+    if (m == expected) return 0;
+    std::printf("%s: detected %s, expected %s\n", what, model_name(m), model_name(expected));
+    return 1;
+}
+
+int main() {
+    const std::vector<uint8_t> vlp16 = make_vlp16();
+    const std::vector<uint8_t> p40 = make_pandar40p();
+    int failures = 0;
+
+    // the VLP-16 packet does pass the per-packet Pandar40P check: detection must not rely on it
+    if (!Pandar40PLayout::check(vlp16.data(), vlp16.size())) {
+        std::printf("test packet does not reproduce the FF EE collision\n");
+        failures++;
+    }
+    failures += expect_model("vlp16 with FF EE in block 1", vlp16, vlp16.size(), MODEL_VLP16);
+    failures += expect_model("pandar40p", p40, p40.size(), MODEL_PANDAR40P);
+    failures += expect_model("pandar64", make_pandar64(), 1194, MODEL_PANDAR64);
+    failures += expect_model("xt32", make_xt32(), 1080, MODEL_PANDARXT32);
+    failures += expect_model("truncated vlp16", vlp16, vlp16.size() - 100, MODEL_AUTO);
+    failures += expect_model("truncated pandar40p", p40, 2 * layout_block_bytes<Pandar40PLayout>(), MODEL_AUTO);
+
+    // pandar40p with one block flag missing
+    std::vector<uint8_t> broken = p40;
+    broken[5 * layout_block_bytes<Pandar40PLayout>()] = 0;
+    failures += expect_model("pandar40p, block 5 flag missing", broken, broken.size(), MODEL_AUTO);
+
+    // the whole frame through the parser: the stream locks to VLP-16 and decodes every record
+    std::vector<u_char> frame(TEST_HEADERS_BYTES + vlp16.size(), 0);
+    frame[12] = 0x08;                               // IPv4
+    frame[14] = 0x45;
+    frame[23] = 17;                                 // UDP
+    const uint16_t udp_len = static_cast<uint16_t>(8 + vlp16.size());
+    frame[38] = udp_len >> 8;
+    frame[39] = udp_len & 0xFF;
+    std::memcpy(frame.data() + TEST_HEADERS_BYTES, vlp16.data(), vlp16.size());
+    PCAP_PacketView view;
+    view.packet_header = { 0, 0, static_cast<uint32_t>(frame.size()), static_cast<uint32_t>(frame.size()) };
+    view.packet_data = frame.data();
+
+    Pandar64Parser parser;
+    PointCloudSoA cloud;
+    parser.parse_packet(view, cloud);
+    if (parser.get_model() != MODEL_VLP16 || cloud.size() != static_cast<size_t>(layout_points<VLP16Layout>())) {
+        std::printf("parser: model %s, %zu points (expected vlp16, %d)\n", model_name(parser.get_model()),
+                    cloud.size(), layout_points<VLP16Layout>());
+        failures++;
+    }
+
+    std::printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
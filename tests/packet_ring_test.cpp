@@ -0,0 +1,88 @@
+//==============================================
+// PacketRing shutdown with a consumer that leaves early
+// Same protocol as the live loop in main.cpp: the capture thread pushes with
+// OVERFLOW_BLOCK until `running` is cleared, then closes the ring. The
+// consumer pops a few packets and breaks out while the ring is full (as on a
+// rejected calibration file); closing the ring from the consumer side must
+// release the blocked push() so the capture thread can be joined.
+//==============================================
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "PcapLib/PacketRing.h"
+
+#define TEST_RING_SLOTS     8
+#define TEST_PACKET_BYTES   64
+#define TEST_CONSUMED       3
+#define TEST_TIMEOUT_MS     2000
+
+// wait up to TEST_TIMEOUT_MS for `flag`
+static bool wait_for(const std::atomic<bool>& flag) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TEST_TIMEOUT_MS);
+    while (!flag.load()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+int main() {
+    std::vector<u_char> data(TEST_PACKET_BYTES, 0xAB);
+    PCAP_PacketView packet;
+    packet.packet_header = { 0, 0, TEST_PACKET_BYTES, TEST_PACKET_BYTES };
+    packet.packet_data = data.data();
+
+    PacketRing ring(TEST_RING_SLOTS, OVERFLOW_BLOCK, TEST_PACKET_BYTES);
+    std::atomic<bool> running {true};
+    std::atomic<bool> capture_done {false};
+    std::atomic<uint64_t> pushed {0};
+    std::thread capture_thread([&] {
+        while (running.load(std::memory_order_relaxed)) {
+            if (ring.push(packet)) pushed++;
+        }
+        ring.close();
+        capture_done.store(true);
+    });
+
+    // consumer: a few packets, then leave while the producer keeps the ring full
+    int failures = 0;
+    PCAP_PacketView view;
+    for (int k = 0; k < TEST_CONSUMED; k++) {
+        if (!ring.wait_front(view, TEST_TIMEOUT_MS)) {
+            std::printf("no packet %d from the capture thread\n", k);
+            failures++;
+            break;
+        }
+        ring.pop();
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TEST_TIMEOUT_MS);
+    while (ring.size() < ring.capacity() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (ring.size() != ring.capacity() || ring.overflows() == 0) {
+        std::printf("ring never filled up (%zu/%zu)\n", ring.size(), ring.capacity());
+        failures++;
+    }
+
+    ring.close();
+    running.store(false);
+    if (!wait_for(capture_done)) {
+        // push() is still blocked: joining would hang
+        std::printf("capture thread blocked in push() after close: FAILED\n");
+        std::fflush(stdout);
+        std::_Exit(1);
+    }
+    capture_thread.join();
+
+    if (pushed.load() != TEST_CONSUMED + ring.capacity()) {
+        std::printf("pushed %llu packets, expected %zu\n",
+                    static_cast<unsigned long long>(pushed.load()), TEST_CONSUMED + ring.capacity());
+        failures++;
+    }
+    std::printf("%llu packets pushed, %zu left in the ring: %s\n",
+                static_cast<unsigned long long>(pushed.load()), ring.size(), failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
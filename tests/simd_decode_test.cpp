@@ -0,0 +1,128 @@
+//==============================================
+// SIMD block decoders vs scalar reference
+// Decodes the same Pandar64 packets - whole, and cut short at every byte of
+// the capture - with each SimdLevel the CPU supports, and checks that the
+// point count and every column of the cloud are bit-identical to SIMD_SCALAR.
+// Levels that detect_simd_level() does not report are skipped.
+//==============================================
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "PcapLib/PCAP_parse.h"
+
+#define TEST_HEADERS_BYTES  42      // Ethernet + IPv4 + UDP
+#define TEST_PAYLOAD_BYTES  1194    // Pandar64 single / dual return packet
+#define TEST_PACKETS        8
+
+static uint32_t rng_state = 12345;
+
+static uint32_t next_random() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// Ethernet/IPv4/UDP frame around a Pandar64 payload with random records:
+// ~1/8 without echo, ~1/8 under MIN_RANGE_M, the rest anywhere up to 262 m
+static std::vector<u_char> make_frame(uint8_t return_mode) {
+    std::vector<u_char> frame(TEST_HEADERS_BYTES + TEST_PAYLOAD_BYTES, 0);
+    frame[12] = 0x08;                               // IPv4
+    frame[14] = 0x45;
+    frame[23] = 17;                                 // UDP
+    const uint16_t udp_len = 8 + TEST_PAYLOAD_BYTES;
+    frame[38] = udp_len >> 8;
+    frame[39] = udp_len & 0xFF;
+
+    uint8_t* p = frame.data() + TEST_HEADERS_BYTES;
+    p[0] = 0xEE;
+    p[1] = 0xFF;
+    p[2] = Pandar64Layout::lasers;
+    p[3] = Pandar64Layout::blocks;
+    uint8_t* blk = p + Pandar64Layout::header_bytes;
+    for (int b = 0; b < Pandar64Layout::blocks; b++) {
+        const uint16_t az = next_random() % AZIMUTH_STEPS;
+        blk[0] = az & 0xFF;
+        blk[1] = az >> 8;
+        uint8_t* rec = blk + 2;
+        for (int l = 0; l < Pandar64Layout::lasers; l++, rec += Pandar64Layout::record_bytes) {
+            uint16_t dist;
+            switch (next_random() % 8) {
+                case 0:  dist = 0; break;
+                case 1:  dist = 1 + next_random() % 70; break;
+                default: dist = next_random() & 0xFFFF; break;
+            }
+            rec[0] = dist & 0xFF;
+            rec[1] = dist >> 8;
+            rec[2] = next_random() & 0xFF;
+        }
+        blk += 2 + PANDAR64_BLOCK_BYTES;
+    }
+    p[Pandar64Layout::return_mode_offset] = return_mode;
+    return frame;
+}
+
+template <typename T>
+static bool same_column(const AlignedColumn<T>& a, const AlignedColumn<T>& b, size_t n) {
+    return n == 0 || std::memcmp(a.data(), b.data(), n * sizeof(T)) == 0;
+}
+
+static bool same_cloud(const PointCloudSoA& a, const PointCloudSoA& b) {
+    const size_t n = a.size();
+    return n == b.size() &&
+           same_column(a.x, b.x, n) && same_column(a.y, b.y, n) && same_column(a.z, b.z, n) &&
+           same_column(a.intensity, b.intensity, n) && same_column(a.laser_id, b.laser_id, n) &&
+           same_column(a.azimuth, b.azimuth, n) && same_column(a.timestamp, b.timestamp, n) &&
+           same_column(a.return_index, b.return_index, n);
+}
+
+int main() {
+    const SimdLevel best = detect_simd_level();
+    const uint8_t modes[] = { RETURN_MODE_STRONGEST, RETURN_MODE_DUAL };
+    int failures = 0;
+
+    for (int level = SIMD_SSE41; level <= SIMD_AVX2; level++) {
+        if (level > best) {
+            std::printf("level %d: not supported by this CPU, skipped\n", level);
+            continue;
+        }
+        Pandar64Parser ref, simd;
+        ref.set_model(MODEL_PANDAR64);
+        simd.set_model(MODEL_PANDAR64);
+        ref.set_simd_level(SIMD_SCALAR);
+        simd.set_simd_level(static_cast<SimdLevel>(level));
+
+        size_t packets = 0, points = 0;
+        rng_state = 12345;
+        for (int k = 0; k < TEST_PACKETS; k++) {
+            const std::vector<u_char> frame = make_frame(modes[k % 2]);
+            // whole packet first, then every shorter capture down to the first block azimuth
+            for (size_t caplen = frame.size(); caplen >= TEST_HEADERS_BYTES + Pandar64Layout::header_bytes + 2; caplen--) {
+                PCAP_PacketView view;
+                view.packet_header = { 0, 0, static_cast<uint32_t>(caplen), static_cast<uint32_t>(frame.size()) };
+                view.packet_data = frame.data();
+
+                PointCloudSoA a, b;
+                ref.parse_packet(view, a);
+                simd.parse_packet(view, b);
+                packets++;
+                points += a.size();
+                if (!same_cloud(a, b)) {
+                    if (failures < 10) {
+                        std::printf("level %d: packet %d caplen %zu differs (%zu vs %zu points)\n",
+                                    level, k, caplen, a.size(), b.size());
+                    }
+                    failures++;
+                }
+            }
+        }
+        const ParseCounts ref_counts = ref.get_stats()->snapshot();
+        const ParseCounts simd_counts = simd.get_stats()->snapshot();
+        if (std::memcmp(ref_counts.value, simd_counts.value, sizeof(ref_counts.value)) != 0) {
+            std::printf("level %d: parse counters differ\n", level);
+            failures++;
+        }
+        std::printf("level %d: %zu packets, %zu points compared\n", level, packets, points);
+    }
+
+    std::printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
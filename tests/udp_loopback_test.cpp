@@ -0,0 +1,136 @@
+//==============================================
+// UDP_receiver loopback
+// Sends Pandar64 payloads to 127.0.0.1 and checks that every datagram comes
+// out of receive_batch() as a frame whose synthesized Ethernet/IPv4/UDP
+// header round-trips through extract_udp_payload(): same payload bytes,
+// loopback addresses and ports in the headers, and the same points as the
+// payload parsed directly.
+//==============================================
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "PcapLib/UDP_receiver.h"
+#include "PcapLib/PCAP_parse.h"
+
+#define TEST_PAYLOAD_BYTES  1194    // Pandar64 single return packet
+#define TEST_DATAGRAMS      32
+#define TEST_TIMEOUT_MS     2000
+
+// Pandar64 payload, packet k: every record has an echo at a distance depending on k
+static std::vector<uint8_t> make_payload(int k) {
+    std::vector<uint8_t> p(TEST_PAYLOAD_BYTES, 0);
+    p[0] = 0xEE;
+    p[1] = 0xFF;
+    p[2] = Pandar64Layout::lasers;
+    p[3] = Pandar64Layout::blocks;
+    uint8_t* blk = p.data() + Pandar64Layout::header_bytes;
+    for (int b = 0; b < Pandar64Layout::blocks; b++, blk += 2 + PANDAR64_BLOCK_BYTES) {
+        const uint16_t az = (k * Pandar64Layout::blocks + b) * 20 % AZIMUTH_STEPS;
+        blk[0] = az & 0xFF;
+        blk[1] = az >> 8;
+        for (int l = 0; l < Pandar64Layout::lasers; l++) {
+            const uint16_t dist = 1000 + 37 * k + l;    // 4 m and up
+            uint8_t* rec = blk + 2 + l * Pandar64Layout::record_bytes;
+            rec[0] = dist & 0xFF;
+            rec[1] = dist >> 8;
+            rec[2] = static_cast<uint8_t>(k + l);
+        }
+    }
+    p[Pandar64Layout::return_mode_offset] = RETURN_MODE_STRONGEST;
+    return p;
+}
+
+static inline uint16_t be16(const u_char* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+int main() {
+    UDP_receiver receiver;
+    if (!receiver.open_socket(0, "127.0.0.1", 1 << 20, 256, 16)) {
+        std::printf("cannot bind a loopback UDP socket\n");
+        return 1;
+    }
+
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in src {};
+    src.sin_family = AF_INET;
+    src.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t src_len = sizeof(src);
+    if (tx < 0 || bind(tx, reinterpret_cast<sockaddr*>(&src), sizeof(src)) != 0 ||
+        getsockname(tx, reinterpret_cast<sockaddr*>(&src), &src_len) != 0) {
+        std::printf("cannot open the sending socket\n");
+        return 1;
+    }
+    sockaddr_in dst {};
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    dst.sin_port = htons(receiver.port());
+
+    std::vector<std::vector<uint8_t>> sent;
+    for (int k = 0; k < TEST_DATAGRAMS; k++) {
+        sent.push_back(make_payload(k));
+        if (sendto(tx, sent.back().data(), sent.back().size(), 0,
+                   reinterpret_cast<sockaddr*>(&dst), sizeof(dst)) != static_cast<ssize_t>(TEST_PAYLOAD_BYTES)) {
+            std::printf("sendto failed: %s\n", std::strerror(errno));
+            return 1;
+        }
+    }
+
+    Pandar64Parser parser, reference;
+    int failures = 0;
+    size_t received = 0;
+    while (received < sent.size()) {
+        const size_t n = receiver.receive_batch(TEST_TIMEOUT_MS);
+        if (n == 0) break;
+        for (size_t m = 0; m < n; m++, received++) {
+            const PCAP_PacketView view = receiver.packet(m);
+            const std::vector<uint8_t>& expect = sent[received];
+            const u_char* frame = view.packet_data;
+            bool ok = view.packet_header.capture_length == UDP_HEADROOM + TEST_PAYLOAD_BYTES &&
+                      view.packet_header.length == view.packet_header.capture_length;
+
+            // headers: IPv4 / UDP, 127.0.0.1 -> 127.0.0.1, sender port -> bound port, lengths
+            const u_char* ip = frame + 14;
+            const u_char* udp = ip + 20;
+            const u_char loopback[4] = { 127, 0, 0, 1 };
+            ok = ok && be16(frame + 12) == 0x0800 && ip[0] == 0x45 && ip[9] == 17 &&
+                 be16(ip + 2) == 20 + 8 + TEST_PAYLOAD_BYTES &&
+                 std::memcmp(ip + 12, loopback, 4) == 0 && std::memcmp(ip + 16, loopback, 4) == 0 &&
+                 be16(udp) == ntohs(src.sin_port) && be16(udp + 2) == receiver.port() &&
+                 be16(udp + 4) == 8 + TEST_PAYLOAD_BYTES;
+
+            // payload found by the parser is exactly what was sent
+            const uint8_t* payload = nullptr;
+            size_t payload_len = 0;
+            ok = ok && parser.extract_udp_payload(frame, view.packet_header.capture_length, payload, payload_len) &&
+                 payload_len == expect.size() && std::memcmp(payload, expect.data(), payload_len) == 0;
+
+            // and decodes like the payload itself (all 384 records are in range)
+            PointCloudSoA cloud;
+            ok = ok && parser.parse_packet(view, cloud) == Pandar64Layout::blocks * Pandar64Layout::lasers &&
+                 parser.get_model() == MODEL_PANDAR64;
+            if (ok) {
+                std::vector<u_char> copy(frame, frame + view.packet_header.capture_length);
+                PCAP_PacketView copy_view = view;
+                copy_view.packet_data = copy.data();
+                PointCloudSoA again;
+                reference.parse_packet(copy_view, again);
+                ok = again.size() == cloud.size() &&
+                     std::memcmp(again.x.data(), cloud.x.data(), cloud.size() * sizeof(float)) == 0 &&
+                     std::memcmp(again.intensity.data(), cloud.intensity.data(), cloud.size()) == 0;
+            }
+            if (!ok) {
+                std::printf("datagram %zu: frame does not round-trip\n", received);
+                failures++;
+            }
+        }
+    }
+    close(tx);
+
+    if (received != sent.size()) {
+        std::printf("received %zu of %zu datagrams\n", received, sent.size());
+        failures++;
+    }
+    std::printf("%zu datagrams checked: %s\n", received, failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}